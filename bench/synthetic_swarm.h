@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <libobjecttracker/object_tracker.h>
+
+#include "motion_capture_tracking/tracked_object.h"
+
+namespace motion_capture_tracking {
+namespace bench {
+
+// Generates tracker configurations and point clouds for a swarm of identical
+// 4-marker decks (the one in launch/node.launch), hovering on a grid.
+//
+// Every object flies a small circle while turning about its yaw axis. The
+// motion is periodic with numFrames frames, so the frames can be replayed in a
+// loop without the tracker ever seeing a jump.
+class SyntheticSwarm
+{
+public:
+  struct Options
+  {
+    size_t numObjects = 1;
+    // frames per period, at frameRate [Hz]
+    size_t numFrames = 100;
+    double frameRate = 100.0;
+    // distance between objects on the grid [m]
+    double spacing = 0.3;
+    // radius of the circle flown by every object [m]
+    double radius = 0.1;
+    // standard deviation of the marker noise [m]
+    double noise = 0.0;
+    // probability that a marker is missing from a frame
+    double dropoutProbability = 0.0;
+    // spurious markers per frame, spread over the flight area
+    size_t numGhosts = 0;
+    uint32_t seed = 42;
+  };
+
+  explicit SyntheticSwarm(const Options& options)
+    : m_options(options)
+  {
+    libobjecttracker::DynamicsConfiguration dynamics;
+    dynamics.maxXVelocity = 2.0;
+    dynamics.maxYVelocity = 2.0;
+    dynamics.maxZVelocity = 3.0;
+    dynamics.maxPitchRate = 20.0;
+    dynamics.maxRollRate = 20.0;
+    dynamics.maxYawRate = 10.0;
+    dynamics.maxRoll = 1.4;
+    dynamics.maxPitch = 1.4;
+    dynamics.maxFitnessScore = 0.001;
+    m_dynamicsConfigurations.push_back(dynamics);
+
+    m_deck.reset(new pcl::PointCloud<pcl::PointXYZ>);
+    m_deck->push_back(pcl::PointXYZ( 0.035, 0.000, 0.000));
+    m_deck->push_back(pcl::PointXYZ( 0.000, 0.035, 0.000));
+    m_deck->push_back(pcl::PointXYZ(-0.035, 0.000, 0.000));
+    m_deck->push_back(pcl::PointXYZ( 0.000,-0.035, 0.000));
+    m_markerConfigurations.push_back(m_deck);
+
+    const size_t columns = std::ceil(std::sqrt(static_cast<double>(options.numObjects)));
+    for (size_t i = 0; i < options.numObjects; ++i) {
+      const Eigen::Vector3f center(
+        (i % columns) * options.spacing,
+        (i / columns) * options.spacing,
+        1.0);
+      m_centers.push_back(center);
+      m_objects.push_back(TrackedObject(
+        0, 0, pose(i, 0), "cf" + std::to_string(i)));
+    }
+
+    // the ghosts are drawn from the area covered by the swarm
+    const float margin = options.radius + options.spacing / 2;
+    m_min = Eigen::Vector3f(-margin, -margin, 0.0);
+    m_max = Eigen::Vector3f(
+      (columns - 1) * options.spacing + margin,
+      ((options.numObjects + columns - 1) / columns - 1) * options.spacing + margin,
+      2.0);
+
+    std::mt19937 rng(options.seed);
+    for (size_t frame = 0; frame < options.numFrames; ++frame) {
+      m_frames.push_back(pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>));
+      render(frame, rng, *m_frames.back());
+    }
+  }
+
+  const std::vector<libobjecttracker::DynamicsConfiguration>& dynamicsConfigurations() const
+  {
+    return m_dynamicsConfigurations;
+  }
+
+  const std::vector<libobjecttracker::MarkerConfiguration>& markerConfigurations() const
+  {
+    return m_markerConfigurations;
+  }
+
+  // objects, initialized with their poses in the first frame
+  const std::vector<TrackedObject>& objects() const
+  {
+    return m_objects;
+  }
+
+  size_t numFrames() const
+  {
+    return m_frames.size();
+  }
+
+  // point cloud of the given frame, in random order
+  const pcl::PointCloud<pcl::PointXYZ>::Ptr& frame(size_t idx) const
+  {
+    return m_frames[idx % m_frames.size()];
+  }
+
+  // acquisition time [s] of the given frame; keeps counting when looping
+  double time(size_t idx) const
+  {
+    return idx / m_options.frameRate;
+  }
+
+  // ground truth of object objectIdx in the given frame
+  Eigen::Affine3f pose(size_t objectIdx, size_t frameIdx) const
+  {
+    // spread the phases, so that neighbors do not move in lockstep
+    const double phase = 2 * M_PI * (static_cast<double>(frameIdx) / m_options.numFrames
+      + static_cast<double>(objectIdx) / std::max<size_t>(m_options.numObjects, 1));
+    const Eigen::Vector3f offset(
+      m_options.radius * std::cos(phase),
+      m_options.radius * std::sin(phase),
+      0.0);
+    Eigen::Affine3f result;
+    result = Eigen::Translation3f(m_centers[objectIdx] + offset)
+      * Eigen::AngleAxisf(phase, Eigen::Vector3f::UnitZ());
+    return result;
+  }
+
+private:
+  void render(size_t frameIdx, std::mt19937& rng, pcl::PointCloud<pcl::PointXYZ>& cloud) const
+  {
+    std::normal_distribution<float> noise(0.0, m_options.noise);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    cloud.clear();
+    for (size_t i = 0; i < m_objects.size(); ++i) {
+      const Eigen::Affine3f transformation = pose(i, frameIdx);
+      for (const auto& marker : *m_deck) {
+        if (m_options.dropoutProbability > 0 && uniform(rng) < m_options.dropoutProbability) {
+          continue;
+        }
+        Eigen::Vector3f point = transformation * marker.getVector3fMap();
+        if (m_options.noise > 0) {
+          point += Eigen::Vector3f(noise(rng), noise(rng), noise(rng));
+        }
+        cloud.push_back(pcl::PointXYZ(point.x(), point.y(), point.z()));
+      }
+    }
+    for (size_t i = 0; i < m_options.numGhosts; ++i) {
+      const Eigen::Vector3f point = m_min + (m_max - m_min).cwiseProduct(Eigen::Vector3f(
+        uniform(rng), uniform(rng), uniform(rng)));
+      cloud.push_back(pcl::PointXYZ(point.x(), point.y(), point.z()));
+    }
+
+    // motion capture systems do not report the markers in any particular order
+    std::shuffle(cloud.points.begin(), cloud.points.end(), rng);
+  }
+
+private:
+  const Options m_options;
+  std::vector<libobjecttracker::DynamicsConfiguration> m_dynamicsConfigurations;
+  std::vector<libobjecttracker::MarkerConfiguration> m_markerConfigurations;
+  pcl::PointCloud<pcl::PointXYZ>::Ptr m_deck;
+  std::vector<Eigen::Vector3f> m_centers;
+  std::vector<TrackedObject> m_objects;
+  Eigen::Vector3f m_min;
+  Eigen::Vector3f m_max;
+  std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> m_frames;
+};
+
+} // namespace bench
+} // namespace motion_capture_tracking
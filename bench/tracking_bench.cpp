@@ -0,0 +1,204 @@
+// Benchmarks of the stages a frame goes through in the node: tracking,
+// conversion of the cloud to a message, and preparation of the tf message.
+//
+// Run e.g. with --benchmark_filter=TrackerUpdate to only time the tracker.
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <ros/serialization.h>
+#include <sensor_msgs/PointCloud.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "motion_capture_tracking/metrics.h"
+#include "motion_capture_tracking/parallel_object_tracker.h"
+#include "motion_capture_tracking/point_cloud_conversion.h"
+#include "motion_capture_tracking/transform_batch.h"
+
+#include "synthetic_swarm.h"
+
+using motion_capture_tracking::bench::SyntheticSwarm;
+
+namespace {
+
+enum Scenario
+{
+  // exact marker positions
+  Clean,
+  // 0.5 mm noise, 5% dropouts and one ghost marker per ten objects
+  Noisy,
+};
+
+SyntheticSwarm::Options swarmOptions(int64_t numObjects, int64_t scenario)
+{
+  SyntheticSwarm::Options options;
+  options.numObjects = numObjects;
+  if (scenario == Noisy) {
+    options.noise = 0.0005;
+    options.dropoutProbability = 0.05;
+    options.numGhosts = (numObjects + 9) / 10;
+  }
+  return options;
+}
+
+void ignoreWarning(const std::string&)
+{
+}
+
+// Runs the tracker on a looping synthetic swarm, reporting latency
+// percentiles per update next to the mean reported by the benchmark itself.
+void trackerUpdate(benchmark::State& state, size_t numThreads, bool crop, bool fixedSize)
+{
+  const SyntheticSwarm swarm(swarmOptions(state.range(0), state.range(1)));
+  motion_capture_tracking::ParallelObjectTracker::Options options;
+  options.numThreads = numThreads;
+  options.crop = crop;
+  options.predict = crop;
+  options.recoveryBudget = crop ? 0.002 : 0;
+  options.fixedSizeRegistration = fixedSize;
+  motion_capture_tracking::ParallelObjectTracker tracker(
+    swarm.dynamicsConfigurations(),
+    swarm.markerConfigurations(),
+    swarm.objects(),
+    options);
+  tracker.setLogWarningCallback(ignoreWarning);
+
+  // let the tracker lock on before measuring
+  size_t frameIdx = 0;
+  for (; frameIdx < swarm.numFrames(); ++frameIdx) {
+    tracker.update(swarm.frame(frameIdx), swarm.time(frameIdx));
+  }
+
+  motion_capture_tracking::Histogram histogram("update", "us");
+  size_t numValid = 0;
+  for (auto _ : state) {
+    motion_capture_tracking::Stopwatch stopwatch;
+    tracker.update(swarm.frame(frameIdx), swarm.time(frameIdx));
+    ++frameIdx;
+    histogram.record(stopwatch.elapsedUs());
+  }
+  for (const auto& object : tracker.objects()) {
+    numValid += object.lastTransformationValid();
+  }
+
+  const auto summary = histogram.collect();
+  state.counters["p50_us"] = summary.p50;
+  state.counters["p90_us"] = summary.p90;
+  state.counters["p99_us"] = summary.p99;
+  state.counters["max_us"] = summary.max;
+  state.counters["frames/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  if (tracker.numPredictions() > 0) {
+    state.counters["fallbacks"] = static_cast<double>(tracker.numFallbacks()) / tracker.numPredictions();
+  }
+  state.counters["tracked"] = static_cast<double>(numValid) / swarm.objects().size();
+  state.SetItemsProcessed(state.iterations() * swarm.objects().size());
+}
+
+void BM_TrackerUpdate(benchmark::State& state)
+{
+  trackerUpdate(state, 1, false, false);
+}
+
+void BM_CroppedTrackerUpdate(benchmark::State& state)
+{
+  trackerUpdate(state, 1, true, false);
+}
+
+void BM_FixedSizeTrackerUpdate(benchmark::State& state)
+{
+  trackerUpdate(state, 1, true, true);
+}
+
+void BM_ParallelTrackerUpdate(benchmark::State& state)
+{
+  trackerUpdate(state, state.range(2), true, true);
+}
+
+void trackerArguments(benchmark::internal::Benchmark* benchmark)
+{
+  benchmark->ArgNames({"objects", "noisy"});
+  for (int scenario : {Clean, Noisy}) {
+    for (int numObjects : {1, 2, 5, 10, 20, 50, 100, 200}) {
+      benchmark->Args({numObjects, scenario});
+    }
+  }
+}
+
+void parallelTrackerArguments(benchmark::internal::Benchmark* benchmark)
+{
+  benchmark->ArgNames({"objects", "noisy", "threads"});
+  for (int numThreads : {2, 4}) {
+    for (int numObjects : {10, 50, 200}) {
+      benchmark->Args({numObjects, Noisy, numThreads});
+    }
+  }
+}
+
+BENCHMARK(BM_TrackerUpdate)->Apply(trackerArguments)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_CroppedTrackerUpdate)->Apply(trackerArguments)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_FixedSizeTrackerUpdate)->Apply(trackerArguments)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_ParallelTrackerUpdate)->Apply(parallelTrackerArguments)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+void BM_ToPointCloud(benchmark::State& state)
+{
+  SyntheticSwarm::Options options = swarmOptions(state.range(0), Noisy);
+  options.numFrames = 1;
+  const SyntheticSwarm swarm(options);
+  sensor_msgs::PointCloud msg;
+  for (auto _ : state) {
+    motion_capture_tracking::toPointCloud(*swarm.frame(0), msg);
+    benchmark::DoNotOptimize(msg.points.data());
+  }
+  state.SetItemsProcessed(state.iterations() * swarm.frame(0)->size());
+}
+
+// as published: the message is reused while no subscriber holds on to it
+void BM_ToPointCloud2(benchmark::State& state)
+{
+  SyntheticSwarm::Options options = swarmOptions(state.range(0), Noisy);
+  options.numFrames = 1;
+  const SyntheticSwarm swarm(options);
+  sensor_msgs::PointCloud2Ptr msg;
+  for (auto _ : state) {
+    if (!msg || !msg.unique()) {
+      msg.reset(new sensor_msgs::PointCloud2);
+    }
+    motion_capture_tracking::toPointCloud2(*swarm.frame(0), *msg);
+    benchmark::DoNotOptimize(msg->data.data());
+  }
+  state.SetItemsProcessed(state.iterations() * swarm.frame(0)->size());
+}
+
+BENCHMARK(BM_ToPointCloud)->RangeMultiplier(10)->Range(1, 1000)->ArgName("objects");
+BENCHMARK(BM_ToPointCloud2)->RangeMultiplier(10)->Range(1, 1000)->ArgName("objects");
+
+// What publishing on /tf costs short of handing the serialized message to the
+// subscribers' connections.
+void BM_TfMessage(benchmark::State& state)
+{
+  SyntheticSwarm::Options options = swarmOptions(state.range(0), Clean);
+  options.numFrames = 1;
+  const SyntheticSwarm swarm(options);
+  const ros::Time stamp(1, 0);
+  motion_capture_tracking::TransformBatch transforms("world");
+  for (auto _ : state) {
+    const auto& objects = swarm.objects();
+    for (size_t i = 0; i < objects.size(); ++i) {
+      const auto& transform = objects[i].transformation();
+      transforms.add(i, objects[i].name(), stamp,
+        transform.translation(), Eigen::Quaternionf(transform.rotation()));
+    }
+    ros::SerializedMessage serialized = ros::serialization::serializeMessage(transforms.message());
+    benchmark::DoNotOptimize(serialized.buf.get());
+    transforms.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * swarm.objects().size());
+}
+
+BENCHMARK(BM_TfMessage)->RangeMultiplier(10)->Range(1, 1000)->ArgName("objects");
+
+} // anonymous namespace
+
+BENCHMARK_MAIN();
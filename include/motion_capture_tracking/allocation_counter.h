@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace motion_capture_tracking {
+
+// Debugging aid to verify that code does not allocate.
+//
+// If built with the CMake option COUNT_ALLOCATIONS, the global operator new is
+// replaced to count the heap allocations of the process. Otherwise nothing is
+// counted. The count covers all threads, so the allocations between two reads
+// include those of the tracking thread pool and the frame acquisition, but
+// also those of unrelated threads (e.g., ROS callbacks) meanwhile.
+bool countingAllocations();
+
+// Number of allocations made by all threads so far
+uint64_t numAllocations();
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "motion_capture_tracking/ring_buffer.h"
+
+namespace motion_capture_tracking {
+
+// Writes point clouds to disk on a background thread.
+//
+// log() copies the cloud into a preallocated slot of a ring buffer; if the
+// writer falls behind, the oldest clouds are dropped, so memory use stays
+// bounded no matter how long the session is. The writer collects records in
+// chunks that are appended to the file with a single write(), at the latest
+// after flushPeriod, and synced to disk every syncPeriod. A crash therefore
+// loses at most the chunk that was being collected.
+//
+// Files use the cloud_log format. Optionally, a new file is started whenever
+// the current one exceeds maxFileSize bytes or maxFileDuration seconds; the
+// files are then named <path>.0000, <path>.0001, ...
+class AsyncCloudLogger
+{
+public:
+  struct Options
+  {
+    std::string path;
+    size_t queueSize = 256;
+    // points preallocated per queue slot
+    size_t reservePoints = 256;
+    size_t chunkSize = 1 << 20;
+    double flushPeriod = 1.0;
+    double syncPeriod = 1.0;
+    // 0 disables rotation by size/time
+    uint64_t maxFileSize = 0;
+    double maxFileDuration = 0;
+  };
+
+  explicit AsyncCloudLogger(const Options& options);
+
+  // Writes all clouds still queued.
+  ~AsyncCloudLogger();
+
+  AsyncCloudLogger(const AsyncCloudLogger&) = delete;
+  AsyncCloudLogger& operator=(const AsyncCloudLogger&) = delete;
+
+  // Queues a cloud for writing. Only one thread may call this.
+  void log(uint32_t millis, const pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+  uint64_t numDropped() const
+  {
+    return m_queue.numDropped();
+  }
+
+  uint64_t numWritten() const
+  {
+    return m_numWritten.load(std::memory_order_relaxed);
+  }
+
+  uint64_t numBytesWritten() const
+  {
+    return m_numBytesWritten.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Record
+  {
+    uint32_t millis;
+    std::vector<float> xyz;
+  };
+
+  void run();
+
+  bool openNextFile();
+
+  void writeChunk();
+
+  void sync();
+
+  void closeFile();
+
+private:
+  const Options m_options;
+  RingBuffer<Record> m_queue;
+  Record m_pending;
+
+  int m_fd;
+  size_t m_fileIdx;
+  uint64_t m_fileSize;
+  std::chrono::steady_clock::time_point m_fileOpened;
+  bool m_unsynced;
+  std::vector<char> m_chunk;
+
+  std::atomic<uint64_t> m_numWritten;
+  std::atomic<uint64_t> m_numBytesWritten;
+  std::thread m_thread;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <ros/time.h>
+
+#include "motion_capture_tracking/ring_buffer.h"
+#include "motion_capture_tracking/tracking_log.h"
+
+namespace motion_capture_tracking {
+
+// Writes the output of the tracker for every frame to a tracking_log file on
+// a background thread.
+//
+// A frame is assembled between begin() and commit() in a preallocated record,
+// which is then swapped into a ring buffer; if the writer falls behind, the
+// oldest frames are dropped. The writer transposes the frames into the
+// columns of the current block, and writes the block with a single pwrite()
+// once it is full, or at the latest after flushPeriod. A partial block is
+// written again in place until it is full; everything else is append-only.
+// Objects whose id does not fit into the capacity are not logged.
+class AsyncTrackingLogger
+{
+public:
+  struct Options
+  {
+    std::string path;
+    // object slots per frame
+    uint32_t capacity = 64;
+    uint32_t framesPerBlock = 256;
+    size_t queueSize = 256;
+    double flushPeriod = 1.0;
+    double syncPeriod = 1.0;
+  };
+
+  explicit AsyncTrackingLogger(const Options& options);
+
+  // Writes all frames still queued.
+  ~AsyncTrackingLogger();
+
+  AsyncTrackingLogger(const AsyncTrackingLogger&) = delete;
+  AsyncTrackingLogger& operator=(const AsyncTrackingLogger&) = delete;
+
+  // Starts a frame. begin(), add(), and commit() may only be called by one
+  // thread.
+  void begin(uint64_t frameId, uint64_t timestamp, const ros::Time& stamp, uint32_t numMarkers);
+
+  // fitness is NaN and iterations 0 if not known
+  void add(
+    uint32_t id,
+    const std::string& name,
+    const Eigen::Vector3f& position,
+    const Eigen::Quaternionf& rotation,
+    bool valid,
+    bool extrapolated,
+    float fitness,
+    int iterations);
+
+  // Queues the frame for writing.
+  void commit();
+
+  uint64_t numDropped() const
+  {
+    return m_queue.numDropped();
+  }
+
+  uint64_t numWritten() const
+  {
+    return m_numWritten.load(std::memory_order_relaxed);
+  }
+
+  // Number of objects not logged since their id exceeds the capacity
+  uint64_t numObjectsDropped() const
+  {
+    return m_numObjectsDropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot
+  {
+    float position[3];
+    float orientation[4];
+    float fitness;
+    uint16_t iterations;
+    uint8_t valid;
+    uint8_t extrapolated;
+  };
+
+  struct Record
+  {
+    uint64_t frameId;
+    uint64_t timestamp;
+    int64_t stamp;
+    uint32_t numMarkers;
+    std::vector<Slot> slots;
+  };
+
+  void run();
+
+  void append(const Record& record);
+
+  // Writes the current block, and the names if they changed
+  void writeBlock();
+
+  // pwrite() of all of data; closes the file on errors
+  bool write(const char* data, size_t size, uint64_t offset);
+
+private:
+  const Options m_options;
+  const uint32_t m_framesPerBlock;
+  const tracking_log::Layout m_layout;
+  RingBuffer<Record> m_queue;
+  Record m_pending;
+  // names as last added, producer side
+  std::vector<std::string> m_names;
+
+  // names of all slots, handed to the writer
+  std::mutex m_namesMutex;
+  std::vector<char> m_sharedNames;
+  std::atomic<bool> m_namesChanged;
+  std::vector<char> m_writtenNames;
+
+  int m_fd;
+  std::vector<char> m_block;
+  uint32_t m_numFrames;
+  // of the current block
+  uint32_t m_numFramesWritten;
+  uint64_t m_blockIdx;
+  bool m_unsynced;
+
+  std::atomic<uint64_t> m_numWritten;
+  std::atomic<uint64_t> m_numObjectsDropped;
+  std::thread m_thread;
+};
+
+} // namespace motion_capture_tracking
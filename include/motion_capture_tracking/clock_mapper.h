@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+#include <ros/time.h>
+
+namespace motion_capture_tracking {
+
+// Maps timestamps of the motion capture clock to ROS time.
+//
+// Every frame provides one observation: the mocap timestamp and the ROS time
+// the frame was received at. Reception is always late by some non-negative,
+// jittery delay, so the mapping follows the lower envelope of the
+// observations: frames arriving earlier than predicted pull the offset down
+// right away, later ones only move it slowly. A steady trend in these offset
+// corrections means the two clocks run at different rates; it is folded into
+// the drift estimate once per window.
+//
+// A jump of the mocap clock (e.g., a restart of the vendor software) resets the
+// mapping.
+class ClockMapper
+{
+public:
+  // windowDuration: interval [s] over which the drift is re-estimated
+  // resetThreshold: deviation [s] from the prediction that resets the mapping
+  explicit ClockMapper(
+    double windowDuration = 10.0,
+    double resetThreshold = 1.0);
+
+  // Adds the observation of a single frame; mocapTime is in us.
+  void update(uint64_t mocapTime, const ros::Time& arrivalTime);
+
+  // Maps mocapTime (in us) to ROS time. Requires initialized().
+  ros::Time map(uint64_t mocapTime) const;
+
+  bool initialized() const
+  {
+    return m_initialized;
+  }
+
+  // ROS time minus mocap time of the latest frame [s]
+  double offset() const;
+
+  // rate difference between the two clocks [ppm]
+  double drift() const
+  {
+    return (m_rate - 1.0) * 1e6;
+  }
+
+  // reception delay of the latest frame relative to the envelope [s]
+  double lastDelay() const
+  {
+    return m_lastDelay;
+  }
+
+  uint64_t numResets() const
+  {
+    return m_numResets;
+  }
+
+private:
+  double predict(uint64_t mocapTime) const;
+
+private:
+  const double m_windowDuration;
+  const double m_resetThreshold;
+
+  bool m_initialized;
+  // mapping: ros = m_refRos + m_rate * (mocap - m_refMocap)
+  uint64_t m_refMocap;
+  double m_refRos;
+  double m_rate;
+
+  uint64_t m_windowStart;
+  double m_windowCorrection;
+  uint64_t m_numWindows;
+
+  uint64_t m_lastMocapTime;
+  double m_lastDelay;
+  uint64_t m_numResets;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+namespace motion_capture_tracking {
+
+// Point cloud log files, using the record layout of libobjecttracker's
+// PointCloudLogger. A file is a plain sequence of records, each
+//
+//   uint32  timestamp [ms]
+//   uint32  number of points N
+//   N x (float32 x, float32 y, float32 z)
+//
+// in little endian (i.e., host) byte order. There is no file header, so files
+// can be appended to and concatenated freely.
+namespace cloud_log {
+
+inline size_t recordSize(size_t numPoints)
+{
+  return 2 * sizeof(uint32_t) + numPoints * 3 * sizeof(float);
+}
+
+// Appends a record to buffer; xyz holds 3 * numPoints floats.
+inline void appendRecord(
+  std::vector<char>& buffer,
+  uint32_t millis,
+  const float* xyz,
+  uint32_t numPoints)
+{
+  const size_t offset = buffer.size();
+  buffer.resize(offset + recordSize(numPoints));
+  char* data = buffer.data() + offset;
+  std::memcpy(data, &millis, sizeof(uint32_t));
+  std::memcpy(data + sizeof(uint32_t), &numPoints, sizeof(uint32_t));
+  if (numPoints > 0) {
+    std::memcpy(data + 2 * sizeof(uint32_t), xyz, numPoints * 3 * sizeof(float));
+  }
+}
+
+// Reads the next record into cloud (reusing its storage). Returns false at the
+// end of the stream or on a truncated record.
+inline bool readRecord(
+  std::istream& stream,
+  uint32_t& millis,
+  pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  uint32_t numPoints;
+  if (!stream.read(reinterpret_cast<char*>(&millis), sizeof(uint32_t))
+      || !stream.read(reinterpret_cast<char*>(&numPoints), sizeof(uint32_t))) {
+    return false;
+  }
+  cloud.resize(numPoints);
+  for (uint32_t i = 0; i < numPoints; ++i) {
+    float xyz[3];
+    if (!stream.read(reinterpret_cast<char*>(xyz), sizeof(xyz))) {
+      return false;
+    }
+    cloud[i].x = xyz[0];
+    cloud[i].y = xyz[1];
+    cloud[i].z = xyz[2];
+  }
+  return true;
+}
+
+} // namespace cloud_log
+} // namespace motion_capture_tracking
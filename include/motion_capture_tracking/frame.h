@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <ros/time.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <libmotioncapture/motioncapture.h>
+
+namespace motion_capture_tracking {
+
+// A single motion capture frame, as handed from the acquisition thread to the
+// tracking thread.
+struct Frame
+{
+  uint64_t frameId;
+  uint64_t timestamp; // as reported by the motion capture system, in us
+  ros::Time arrivalTime; // when waitForNextFrame() returned
+  uint64_t acquisitionTime; // from arrivalTime until the frame was queued, in us
+  // Recycled from frame to frame, so that its storage is reused. Holds the
+  // previous content or may be null if hasMarkers is false.
+  pcl::PointCloud<pcl::PointXYZ>::Ptr markers;
+  bool hasMarkers; // false if the point cloud was not needed
+  std::vector<libmotioncapture::Object> rigidBodies; // motionCapture mode only
+
+  Frame()
+    : frameId(0)
+    , timestamp(0)
+    , acquisitionTime(0)
+    , hasMarkers(false)
+  {
+  }
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "motion_capture_tracking/frame.h"
+#include "motion_capture_tracking/frame_source.h"
+#include "motion_capture_tracking/ring_buffer.h"
+
+namespace motion_capture_tracking {
+
+// Acquires frames from a FrameSource on a background thread and hands them to
+// the consumer through a ring buffer, which can be waited on with a timeout.
+//
+// Motion capture SDKs block in waitForNextFrame() without a timeout. The
+// thread therefore only works on a state shared with this object, source and
+// ring included, so that an SDK that does not return anymore can be left behind
+// on shutdown instead of hanging it.
+class FrameAcquisition
+{
+public:
+  typedef RingBuffer<Frame> FrameQueue;
+
+  FrameAcquisition(
+    std::unique_ptr<FrameSource> source,
+    size_t queueSize,
+    FrameQueue::OverflowPolicy policy);
+
+  // Calls stop() with a timeout of one second
+  ~FrameAcquisition();
+
+  void start();
+
+  // Consumer only. Waits up to timeout for the next frame and swaps it into
+  // frame. Returns false on timeout and once all frames have been consumed
+  // after the source ended; finished() tells the two apart.
+  template<class Rep, class Period>
+  bool pop(Frame& frame, const std::chrono::duration<Rep, Period>& timeout)
+  {
+    return m_state->queue.pop(frame, timeout);
+  }
+
+  // true once the source has no more frames (or stop() was called)
+  bool finished() const
+  {
+    return m_state->queue.closed();
+  }
+
+  // Whether the point cloud is pulled from the source, e.g., only while it is
+  // needed. Takes effect with the next frame.
+  void setWithPointCloud(bool withPointCloud)
+  {
+    m_state->withPointCloud.store(withPointCloud, std::memory_order_relaxed);
+  }
+
+  bool supportsObjectTracking() const
+  {
+    return m_state->source->supportsObjectTracking();
+  }
+
+  // Ends the acquisition, interrupts the source, and waits up to timeout for
+  // the thread. If the source is still blocked by then, the thread is detached
+  // and cleans up whenever the source returns. Returns false in that case.
+  bool stop(std::chrono::milliseconds timeout);
+
+  uint64_t numPushed() const
+  {
+    return m_state->queue.numPushed();
+  }
+
+  uint64_t numDropped() const
+  {
+    return m_state->queue.numDropped();
+  }
+
+  uint64_t numBlocked() const
+  {
+    return m_state->queue.numBlocked();
+  }
+
+private:
+  struct State
+  {
+    State(
+      std::unique_ptr<FrameSource> source,
+      size_t queueSize,
+      FrameQueue::OverflowPolicy policy);
+
+    std::unique_ptr<FrameSource> source;
+    FrameQueue queue;
+    std::atomic<bool> withPointCloud;
+
+    std::mutex mutex;
+    std::condition_variable finishedCondition;
+    bool threadFinished;
+  };
+
+  static void run(std::shared_ptr<State> state);
+
+private:
+  std::shared_ptr<State> m_state;
+  bool m_started;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace motion_capture_tracking {
+
+// Watches the frame intervals of a stream, to report gaps and stalls.
+//
+// The nominal interval is the upper quartile of the latest frame intervals.
+// Single gaps do not move it, frames that arrive bunched (e.g., in pairs) do
+// not make the longer intervals between the bunches look like gaps, and it
+// follows a lower frame rate within a quarter of the window and a higher one
+// within three quarters. A frame that arrives more than timeoutFactor nominal
+// intervals after the previous one follows a gap; if no frame arrives for that
+// long at all, the stream is considered lost until the next frame.
+class FrameMonitor
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit FrameMonitor(double timeoutFactor = 2.0);
+
+  // Adds a frame received at the given time; interval [us] is the time since
+  // the previous frame, preferably by the mocap clock, or 0 if unknown.
+  // Returns true if the frame follows a gap.
+  bool frame(uint64_t interval, Clock::time_point arrivalTime);
+
+  // Returns true once the stream is lost, i.e., once per stall.
+  bool checkStall(Clock::time_point now);
+
+  // Time left until the stream is considered lost, or a negative duration if
+  // no nominal interval has been observed yet.
+  Clock::duration timeUntilStall(Clock::time_point now) const;
+
+  // [us], 0 until the second frame
+  double nominalInterval() const
+  {
+    return m_nominalInterval;
+  }
+
+  bool lost() const
+  {
+    return m_lost;
+  }
+
+  // duration of the latest gap or stall [us]
+  uint64_t lastGap() const
+  {
+    return m_lastGap;
+  }
+
+  uint64_t numGaps() const
+  {
+    return m_numGaps;
+  }
+
+  uint64_t numLosses() const
+  {
+    return m_numLosses;
+  }
+
+private:
+  static const size_t WindowSize = 31;
+
+  double m_timeoutFactor;
+
+  // ring of the latest intervals [us]
+  std::array<uint64_t, WindowSize> m_intervals;
+  size_t m_numIntervals;
+  size_t m_nextInterval;
+  double m_nominalInterval;
+  bool m_hasFrame;
+  Clock::time_point m_lastArrival;
+  bool m_lost;
+  uint64_t m_lastGap;
+  uint64_t m_numGaps;
+  uint64_t m_numLosses;
+};
+
+} // namespace motion_capture_tracking
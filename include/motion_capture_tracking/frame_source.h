@@ -0,0 +1,55 @@
+#pragma once
+
+#include <libmotioncapture/motioncapture.h>
+
+#include "motion_capture_tracking/frame.h"
+
+namespace motion_capture_tracking {
+
+// Source of motion capture frames, polled by the acquisition thread.
+class FrameSource
+{
+public:
+  virtual ~FrameSource()
+  {
+  }
+
+  // Blocks until the next frame is available and fills frame (except for
+  // frameId), reusing its storage. The point cloud may be skipped if
+  // withPointCloud is false. Returns false once the source has no more
+  // frames.
+  virtual bool waitForNextFrame(Frame& frame, bool withPointCloud) = 0;
+
+  // Whether frames carry rigid bodies solved by the motion capture system
+  virtual bool supportsObjectTracking() const = 0;
+
+  // Asks a blocked waitForNextFrame() to return false as soon as it can. Called
+  // from another thread when acquisition stops; SDKs that block without a
+  // timeout cannot be interrupted.
+  virtual void interrupt()
+  {
+  }
+};
+
+// Live frames from a motion capture system, via libmotioncapture
+class MocapFrameSource : public FrameSource
+{
+public:
+  // Takes ownership of mocap. Rigid bodies are only queried if
+  // withRigidBodies is set.
+  MocapFrameSource(
+    libmotioncapture::MotionCapture* mocap,
+    bool withRigidBodies);
+
+  virtual ~MocapFrameSource();
+
+  virtual bool waitForNextFrame(Frame& frame, bool withPointCloud);
+
+  virtual bool supportsObjectTracking() const;
+
+private:
+  libmotioncapture::MotionCapture* m_mocap;
+  const bool m_withRigidBodies;
+};
+
+} // namespace motion_capture_tracking
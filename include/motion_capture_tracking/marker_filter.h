@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+namespace motion_capture_tracking {
+
+// Removes markers that cannot belong to a tracked object before the cloud is
+// handed to the tracker, in three stages:
+//
+// - volume: markers outside an axis-aligned box, or outside a polygon in the
+//   x-y plane (e.g., the floor plan of the flight volume).
+// - static: markers at a place that was occupied in most of the first
+//   staticFrames frames, such as calibration markers or reflections. Places
+//   within a protected sphere (around the initial position of every object,
+//   which sits still at startup, as large as the object) are never learned.
+// - duplicates: markers within minDistance of another marker that was kept
+//   (e.g., of a reflection next to the real marker).
+//
+// Every stage first computes a mask over the whole cloud and then compacts the
+// cloud. The volume masks are computed point by point in loops without
+// branches, which the compiler vectorizes; the other stages look up a grid.
+// Once the static places are learned, filter() does not allocate anymore.
+class MarkerFilter
+{
+public:
+  struct Options
+  {
+    // disabled unless boxMin < boxMax on all axes [m]
+    Eigen::Vector3f boxMin = Eigen::Vector3f::Zero();
+    Eigen::Vector3f boxMax = Eigen::Vector3f::Zero();
+    // vertices in the x-y plane [m], disabled if fewer than 3
+    std::vector<Eigen::Vector2f> polygon;
+
+    // 0 to disable
+    size_t staticFrames = 0;
+    // [m]
+    float staticCellSize = 0.02;
+    // share of the learning frames a place has to be occupied in
+    float staticFraction = 0.9;
+    // centers and radii [m] of the protected spheres
+    std::vector<Eigen::Vector3f> protectedPositions;
+    std::vector<float> protectedRadii;
+
+    // 0 to disable [m]
+    float minDistance = 0;
+  };
+
+  explicit MarkerFilter(const Options& options);
+
+  // Whether any stage is enabled
+  bool enabled() const;
+
+  // Removes the filtered markers from cloud.
+  void filter(pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+  // true until staticFrames frames have been seen
+  bool learning() const
+  {
+    return m_numFrames < m_options.staticFrames;
+  }
+
+  // Number of markers removed by each stage so far; may be queried from any
+  // thread
+  uint64_t numOutside() const
+  {
+    return m_numOutside.load(std::memory_order_relaxed);
+  }
+
+  uint64_t numStatic() const
+  {
+    return m_numStatic.load(std::memory_order_relaxed);
+  }
+
+  uint64_t numDuplicates() const
+  {
+    return m_numDuplicates.load(std::memory_order_relaxed);
+  }
+
+private:
+  // removes all points whose m_keep is 0, returns their number
+  size_t compact(pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+  void cropVolume(const pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+  void learnStatic(const pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+  void maskStatic(const pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+  void maskDuplicates(const pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+private:
+  const Options m_options;
+  const bool m_useBox;
+
+  size_t m_numFrames;
+  // place -> (frames it was occupied in, last frame), while learning
+  std::unordered_map<uint64_t, std::pair<size_t, size_t> > m_occupancy;
+  std::unordered_set<uint64_t> m_staticCells;
+
+  std::vector<uint8_t> m_keep;
+  std::vector<uint8_t> m_inside;
+  // (cell, point index), sorted
+  std::vector<std::pair<uint64_t, uint32_t> > m_cells;
+
+  std::atomic<uint64_t> m_numOutside;
+  std::atomic<uint64_t> m_numStatic;
+  std::atomic<uint64_t> m_numDuplicates;
+};
+
+} // namespace motion_capture_tracking
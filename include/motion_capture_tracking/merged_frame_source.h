@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <ros/time.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "motion_capture_tracking/clock_mapper.h"
+#include "motion_capture_tracking/frame_acquisition.h"
+#include "motion_capture_tracking/frame_source.h"
+#include "motion_capture_tracking/voxel_hash.h"
+
+namespace motion_capture_tracking {
+
+// Merges the point clouds of several motion capture systems covering
+// neighboring or overlapping volumes, calibrated to the same world frame.
+//
+// Every source is acquired on its own thread by a FrameAcquisition. The first
+// source is the primary one: each of its frames yields one merged frame, with
+// its timestamp and arrival time. The frames of all sources are mapped to ROS
+// time by a ClockMapper per source. Of every other source, the frame nearest
+// in time to the primary frame is merged if it is within maxSkew of it, and
+// every frame is merged at most once. If no such frame is there yet, it is
+// waited for up to maxSkew; a source that delivered nothing meanwhile is not
+// waited for again until its next frame arrives.
+//
+// Markers seen by several systems in an overlap region are suppressed: a
+// marker within duplicateDistance of a marker already in the merged cloud
+// (from an earlier source in the list) is dropped.
+class MergedFrameSource : public FrameSource
+{
+public:
+  struct Options
+  {
+    // [s]
+    double maxSkew = 0.005;
+    // [m]
+    float duplicateDistance = 0.005;
+    // frames buffered per source
+    size_t queueSize = 4;
+  };
+
+  explicit MergedFrameSource(
+    std::vector<std::unique_ptr<FrameSource> > sources,
+    const Options& options);
+
+  virtual ~MergedFrameSource();
+
+  virtual bool waitForNextFrame(Frame& frame, bool withPointCloud);
+
+  // Rigid bodies are not merged
+  virtual bool supportsObjectTracking() const
+  {
+    return false;
+  }
+
+  virtual void interrupt();
+
+  // secondary frames merged into a primary frame
+  uint64_t numMerged() const
+  {
+    return m_numMerged.load(std::memory_order_relaxed);
+  }
+
+  // secondary frames missing, or too far off in time, for a primary frame
+  uint64_t numSkipped() const
+  {
+    return m_numSkipped.load(std::memory_order_relaxed);
+  }
+
+  // duplicate markers dropped
+  uint64_t numDuplicates() const
+  {
+    return m_numDuplicates.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Input
+  {
+    std::unique_ptr<FrameAcquisition> acquisition;
+    ClockMapper clockMapper;
+    // the latest frame up to the time of the primary frame
+    Frame frame;
+    bool hasFrame;
+    bool consumed;
+    ros::Time time;
+    // the first frame after it
+    Frame next;
+    bool hasNext;
+    ros::Time nextTime;
+    // nothing arrived while waiting
+    bool stalled;
+  };
+
+  // Pops a frame into input.next unless it holds one already
+  bool pop(Input& input, std::chrono::microseconds timeout);
+
+  // Moves the frames up to time into input.frame
+  void advance(Input& input, const ros::Time& time);
+
+  // Returns the frame of input nearest to time, if within maxSkew and not
+  // merged yet, and marks it as merged
+  const Frame* match(Input& input, const ros::Time& time);
+
+  void merge(const pcl::PointCloud<pcl::PointXYZ>& cloud, pcl::PointCloud<pcl::PointXYZ>& merged);
+
+private:
+  const Options m_options;
+  std::vector<Input> m_inputs;
+  std::atomic<bool> m_interrupted;
+
+  VoxelHash m_voxelHash;
+  pcl::PointCloud<pcl::PointXYZ> m_neighbors;
+  pcl::PointCloud<pcl::PointXYZ> m_accepted;
+
+  std::atomic<uint64_t> m_numMerged;
+  std::atomic<uint64_t> m_numSkipped;
+  std::atomic<uint64_t> m_numDuplicates;
+};
+
+} // namespace motion_capture_tracking
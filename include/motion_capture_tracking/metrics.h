@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+namespace motion_capture_tracking {
+
+// Monotonically increasing count; reported as running total.
+class Counter
+{
+public:
+  explicit Counter(const std::string& name)
+    : m_name(name)
+    , m_value(0)
+  {
+  }
+
+  void increment(uint64_t amount = 1)
+  {
+    m_value.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  uint64_t value() const
+  {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+  const std::string& name() const
+  {
+    return m_name;
+  }
+
+private:
+  const std::string m_name;
+  std::atomic<uint64_t> m_value;
+};
+
+// Latest value of some quantity.
+class Gauge
+{
+public:
+  explicit Gauge(const std::string& name)
+    : m_name(name)
+    , m_value(0)
+  {
+  }
+
+  void set(double value)
+  {
+    m_value.store(value, std::memory_order_relaxed);
+  }
+
+  double value() const
+  {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+  const std::string& name() const
+  {
+    return m_name;
+  }
+
+private:
+  const std::string m_name;
+  std::atomic<double> m_value;
+};
+
+// Distribution of non-negative integer samples, e.g. durations in us.
+//
+// Buckets are log-linear: each power of two is split into four buckets, so
+// reported percentiles are within 25% of the true value. Recording is a few
+// relaxed atomic increments; summaries cover the samples since the previous
+// summary.
+class Histogram
+{
+public:
+  struct Summary
+  {
+    uint64_t count;
+    double mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t max;
+  };
+
+  Histogram(const std::string& name, const std::string& unit);
+
+  void record(uint64_t value);
+
+  // Summarizes and clears the samples recorded so far. Only one thread may
+  // call this at a time.
+  Summary collect();
+
+  const std::string& name() const
+  {
+    return m_name;
+  }
+
+  const std::string& unit() const
+  {
+    return m_unit;
+  }
+
+private:
+  static const size_t SubBucketBits = 2;
+  static const size_t NumBuckets = (64 + 1) << SubBucketBits;
+
+  static size_t bucketIndex(uint64_t value);
+
+  static uint64_t bucketUpperBound(size_t idx);
+
+private:
+  const std::string m_name;
+  const std::string m_unit;
+  std::atomic<uint64_t> m_buckets[NumBuckets];
+  std::atomic<uint64_t> m_count;
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_max;
+};
+
+// Measures the time since construction (or the last restart()) in us.
+class Stopwatch
+{
+public:
+  Stopwatch()
+    : m_start(std::chrono::steady_clock::now())
+  {
+  }
+
+  void restart()
+  {
+    m_start = std::chrono::steady_clock::now();
+  }
+
+  uint64_t elapsedUs() const
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - m_start).count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point m_start;
+};
+
+// Registry of all metrics of the node.
+//
+// Metrics are created at startup and then updated lock-free from any thread;
+// references stay valid for the lifetime of the registry.
+class Metrics
+{
+public:
+  Counter& counter(const std::string& name);
+
+  Gauge& gauge(const std::string& name);
+
+  Histogram& histogram(const std::string& name, const std::string& unit);
+
+  // value is queried whenever the metrics are reported, from the reporting
+  // thread
+  void addCallback(const std::string& name, std::function<double()> value);
+
+  // Appends the current values to status. Histograms are summarized (and
+  // cleared) in the process.
+  void report(diagnostic_msgs::DiagnosticStatus& status);
+
+private:
+  std::mutex m_mutex;
+  std::deque<Counter> m_counters;
+  std::deque<Gauge> m_gauges;
+  std::deque<Histogram> m_histograms;
+  std::deque<std::pair<std::string, std::function<double()> > > m_callbacks;
+};
+
+// Publishes the metrics periodically as diagnostic_msgs/DiagnosticArray from
+// a background thread.
+class MetricsReporter
+{
+public:
+  MetricsReporter(
+    Metrics& metrics,
+    ros::NodeHandle& nh,
+    const std::string& name,
+    double period);
+
+  ~MetricsReporter();
+
+private:
+  void run();
+
+private:
+  Metrics& m_metrics;
+  ros::Publisher m_publisher;
+  const std::string m_name;
+  const std::chrono::duration<double> m_period;
+
+  std::mutex m_mutex;
+  std::condition_variable m_stopCondition;
+  bool m_stop;
+  std::thread m_thread;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <libobjecttracker/object_tracker.h>
+
+#include "motion_capture_tracking/metrics.h"
+#include "motion_capture_tracking/rigid_registration.h"
+#include "motion_capture_tracking/thread_pool.h"
+#include "motion_capture_tracking/tracked_object.h"
+#include "motion_capture_tracking/voxel_hash.h"
+
+namespace motion_capture_tracking {
+
+// Drop-in replacement for libobjecttracker::ObjectTracker that can track the
+// objects on several threads, on cropped point clouds, and with a registration
+// kernel specialized for small marker configurations; see Options.
+//
+// With numThreads <= 1 and all other options disabled, all objects are handled
+// by a single ObjectTracker, just as before. Otherwise every object is tracked
+// on its own, and with numThreads > 1 on a persistent ThreadPool. Each object
+// only ever sees the frame's point cloud and its own state, so unlike the
+// single ObjectTracker, objects are initialized independently of each other.
+// Conflicts between them are resolved afterwards on the calling thread, in an
+// order that does not depend on the scheduling.
+//
+// Objects and marker configurations can be added, and objects removed or
+// reset, between two calls of update(). The state of all other objects is
+// kept; removing an object shifts the indices of all later ones down by one.
+// This is not available with the single ObjectTracker of the first mode.
+class ParallelObjectTracker
+{
+public:
+  struct Options
+  {
+    // 0 or 1: track on the calling thread only
+    size_t numThreads = 0;
+    // The frame's cloud is indexed once by a VoxelHash, and every object that
+    // has been tracked before only gets the markers within the box it can
+    // have reached since its last valid pose, given the velocity limits of its
+    // DynamicsConfiguration. ICP then runs over a handful of markers instead
+    // of the whole cloud, and cannot lock on to markers of other objects.
+    bool crop = false;
+    // added to the extent of the marker configuration [m]
+    float cropMargin = 0.05;
+    // Objects tracked in consecutive frames are first tracked within a
+    // tighter box around the position extrapolated with their last velocity,
+    // and only if that fails within the box above (a fallback). Requires crop,
+    // and only applies to objects with a FixedRigidRegistration.
+    bool predict = false;
+    // deviation from the predicted position allowed per axis [m]
+    float predictionTolerance = 0.01;
+    // Objects with 3 to 6 markers are registered by a FixedRigidRegistration,
+    // seeded with the predicted pose, and validated against the
+    // DynamicsConfiguration here, as libobjecttracker would. Objects with more
+    // markers stay with libobjecttracker, whose ICP seeds itself with the last
+    // pose.
+    bool fixedSizeRegistration = false;
+    int maxIterations = 10;
+    // edge length of the cells objects are ordered by [m], 0 to disable.
+    // With numThreads > 1, objects are handed to the ThreadPool in the Morton
+    // order of the cell of their last position, so that the contiguous range
+    // of every thread mostly holds neighbouring objects. This is an ordering
+    // only: all threads still crop from the frame's VoxelHash.
+    float orderCellSize = 1.0;
+    // time per frame for recovering lost objects [s], 0 to track them along
+    // with all others. Requires crop. Lost objects are kept in a queue, and
+    // once all healthy objects are tracked, search the markers not assigned
+    // to them, within the box they can have reached since they were lost;
+    // objects never found search the whole cloud. The objects lost most
+    // recently go first, and the others wait for the next frame once the
+    // budget is spent.
+    double recoveryBudget = 0;
+    // markers closer to a tracked object's marker per axis are assigned [m];
+    // also the distance at which two objects conflict. Every object claims
+    // the closest marker within it of each of its markers, and objects are
+    // accepted in a fixed order: objects tracked in the previous frame before
+    // objects found anew, then by fitness and index. An object that claims two
+    // or more markers of an accepted one is not valid in this frame; a single
+    // common marker is left to noise.
+    float assignmentDistance = 0.01;
+    // time per frame for update() [s], 0 to never degrade. The tracker
+    // degrades by one Degradation level after every frame that missed it, and
+    // steps back after a run of frames within it.
+    double deadline = 0;
+    // of fixed-size registrations once degraded
+    int degradedMaxIterations = 3;
+    // objects up to this priority are predicted at the last level
+    int predictionPriority = 0;
+  };
+
+  // levels of degradation, each including all earlier ones
+  enum class Degradation
+  {
+    None,
+    // fixed-size registrations stop after degradedMaxIterations
+    FewerIterations,
+    // the recovery stops at the deadline rather than after its budget, but
+    // still attempts the first object
+    LimitRecovery,
+    // objects up to predictionPriority are only solved every other frame; in
+    // between, their pose is extrapolated with their last velocity and
+    // reported as valid, flagged by TrackedObject
+    PredictLowPriority,
+  };
+
+  ParallelObjectTracker(
+    const std::vector<libobjecttracker::DynamicsConfiguration>& dynamicsConfigurations,
+    const std::vector<libobjecttracker::MarkerConfiguration>& markerConfigurations,
+    const std::vector<TrackedObject>& objects,
+    const Options& options);
+
+  // time [s] is the acquisition time of the frame
+  void update(pcl::PointCloud<pcl::PointXYZ>::Ptr pointCloud, double time);
+
+  const std::vector<TrackedObject>& objects() const;
+
+  const std::vector<libobjecttracker::MarkerConfiguration>& markerConfigurations() const;
+
+  // Fitness [m^2] of the last registration of object idx in the last frame,
+  // NaN if not known (e.g., the object was tracked by libobjecttracker or
+  // extrapolated)
+  float fitness(size_t idx) const;
+
+  // Number of ICP iterations of object idx in the last frame, 0 if not known
+  int iterations(size_t idx) const;
+
+  void setLogWarningCallback(std::function<void(const std::string&)> logWarn);
+
+  // Whether objects can be added, removed, and reset
+  bool supportsChanges() const
+  {
+    return !m_tracker;
+  }
+
+  // Appends a marker configuration for objects added later; idx receives its
+  // index. Returns false if not supported.
+  bool addMarkerConfiguration(const libobjecttracker::MarkerConfiguration& markers, size_t& idx);
+
+  // Appends an object, which is searched for around its initial pose. Returns
+  // false if not supported or if a configuration index is out of range.
+  bool addObject(const TrackedObject& object);
+
+  bool removeObject(size_t idx);
+
+  // Forgets the state of object idx, which is then searched for around the
+  // given pose as if it had just been added.
+  bool resetObject(size_t idx, const Eigen::Affine3f& transformation);
+
+  // Receives the distance [um] between the predicted and the tracked position
+  // of every successful prediction. Must outlive the tracker.
+  void setPredictionErrorHistogram(Histogram* histogram);
+
+  // Receives the number of ICP iterations of every fixed-size registration.
+  // Must outlive the tracker.
+  void setIterationsHistogram(Histogram* histogram);
+
+  // Number of tracking attempts around a predicted position so far; may be
+  // queried from any thread
+  uint64_t numPredictions() const
+  {
+    return m_numPredictions.load(std::memory_order_relaxed);
+  }
+
+  // Number of predictions that failed and were retried
+  uint64_t numFallbacks() const
+  {
+    return m_numFallbacks.load(std::memory_order_relaxed);
+  }
+
+  // Number of poses rejected since another object had claimed their markers
+  uint64_t numConflicts() const
+  {
+    return m_numConflicts.load(std::memory_order_relaxed);
+  }
+
+  // Number of lost objects found again by the recovery
+  uint64_t numRecoveries() const
+  {
+    return m_numRecoveries.load(std::memory_order_relaxed);
+  }
+
+  // Number of recovery attempts postponed to a later frame for lack of time
+  uint64_t numDeferrals() const
+  {
+    return m_numDeferrals.load(std::memory_order_relaxed);
+  }
+
+  // Number of frames update() took longer than the deadline
+  uint64_t numDeadlineMisses() const
+  {
+    return m_numDeadlineMisses.load(std::memory_order_relaxed);
+  }
+
+  // Number of changes of the degradation level, up or down
+  uint64_t numDegradationChanges() const
+  {
+    return m_numDegradationChanges.load(std::memory_order_relaxed);
+  }
+
+  Degradation degradation() const
+  {
+    return static_cast<Degradation>(m_degradation.load(std::memory_order_relaxed));
+  }
+
+  // Number of poses predicted instead of solved
+  uint64_t numPredicted() const
+  {
+    return m_numPredicted.load(std::memory_order_relaxed);
+  }
+
+private:
+  // per-object state
+  struct Shard
+  {
+    // exactly one of both is set
+    std::unique_ptr<libobjecttracker::ObjectTracker> tracker;
+    std::unique_ptr<RigidRegistration> registration;
+    libobjecttracker::DynamicsConfiguration dynamics;
+    libobjecttracker::MarkerConfiguration markers;
+
+    // distance of the farthest marker from the origin [m]
+    float radius;
+    // half size of the crop box at rest, and its growth [m/s]
+    Eigen::Vector3f cropExtent;
+    Eigen::Vector3f maxVelocity;
+
+    bool tracked;
+    double lastValidTime;
+    Eigen::Vector3f lastPosition;
+    bool hasVelocity;
+    Eigen::Vector3f velocity;
+    // in the recovery queue
+    bool lost;
+    // pose extrapolated instead of solved in the last frame
+    bool extrapolated;
+
+    // outcome of the current frame
+    // tracked in this frame; the motion model is updated once conflicts are
+    // resolved
+    bool solved;
+    Eigen::Affine3f previousPose;
+    bool hasClaims;
+    std::vector<Eigen::Vector3f> claims;
+    bool predicted;
+    bool fallback;
+    float predictionError;
+    float fitness;
+    int iterations;
+    bool attempted;
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+  };
+
+  void initShard(Shard& shard, const TrackedObject& object);
+
+  void updateObject(size_t idx, const pcl::PointCloud<pcl::PointXYZ>::Ptr& pointCloud, double time);
+
+  // Runs the recovery queue on the markers not assigned to healthy objects
+  void recover(const pcl::PointCloud<pcl::PointXYZ>& pointCloud, double time);
+
+  void recoverObject(size_t idx, double time);
+
+  // Rejects the poses of the solved objects that claim markers of another
+  // one, in a deterministic order, and adds the others to m_accepted
+  void resolveConflicts();
+
+  // Whether objects a and b at their current poses claim two or more common
+  // markers
+  bool conflict(size_t a, size_t b);
+
+  // Markers of the frame claimed by object idx, computed once per frame
+  const std::vector<Eigen::Vector3f>& claims(size_t idx);
+
+  // Updates the motion model of object idx after a tracking attempt
+  void finishObject(size_t idx, bool valid, double time);
+
+  // Whether object idx is extrapolated instead of tracked in this frame, at
+  // the current degradation
+  bool extrapolate(size_t idx) const;
+
+  // Adapts the degradation to the duration of the last update() [s]
+  void degrade(double duration);
+
+  // Tracks object idx on cloud, starting from guess; returns whether the new
+  // pose is valid.
+  bool track(
+    size_t idx,
+    const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
+    const Eigen::Affine3f& guess,
+    double time);
+
+  // checks of libobjecttracker: fitness, attitude, and rates
+  bool validate(
+    const Shard& shard,
+    const TrackedObject& object,
+    const RigidRegistration::Result& result,
+    double time) const;
+
+private:
+  const Options m_options;
+  std::vector<libobjecttracker::DynamicsConfiguration> m_dynamicsConfigurations;
+  std::vector<libobjecttracker::MarkerConfiguration> m_markerConfigurations;
+  std::function<void(const std::string&)> m_logWarn;
+  std::unique_ptr<libobjecttracker::ObjectTracker> m_tracker;
+  std::vector<Shard> m_shards;
+  std::vector<TrackedObject> m_objects;
+  std::unique_ptr<ThreadPool> m_pool;
+  // (Morton key of the cell, object index), sorted; ordering only
+  std::vector<std::pair<uint64_t, uint32_t> > m_order;
+  // solved objects, in the order of acceptance, and the ones accepted in this
+  // frame
+  std::vector<uint32_t> m_candidates;
+  std::vector<uint32_t> m_accepted;
+  // lost objects
+  std::vector<uint32_t> m_recoveryQueue;
+  pcl::PointCloud<pcl::PointXYZ> m_assignedMarkers;
+  VoxelHash m_assignedVoxels;
+  pcl::PointCloud<pcl::PointXYZ> m_neighbors;
+  pcl::PointCloud<pcl::PointXYZ>::Ptr m_unassigned;
+  VoxelHash m_unassignedVoxels;
+
+  VoxelHash m_voxels;
+  double m_lastTime;
+  // of the current frame
+  std::chrono::steady_clock::time_point m_deadline;
+  int m_maxIterations;
+  // frames in a row well within the deadline
+  size_t m_numCalmFrames;
+
+  Histogram* m_predictionErrorHistogram;
+  Histogram* m_iterationsHistogram;
+  std::atomic<uint64_t> m_numPredictions;
+  std::atomic<uint64_t> m_numFallbacks;
+  std::atomic<uint64_t> m_numConflicts;
+  std::atomic<uint64_t> m_numRecoveries;
+  std::atomic<uint64_t> m_numDeferrals;
+  std::atomic<uint64_t> m_numDeadlineMisses;
+  std::atomic<uint64_t> m_numDegradationChanges;
+  std::atomic<int> m_degradation;
+  std::atomic<uint64_t> m_numPredicted;
+};
+
+} // namespace motion_capture_tracking
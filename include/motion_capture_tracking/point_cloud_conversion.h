@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstring>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <sensor_msgs/PointCloud.h>
+#include <sensor_msgs/PointCloud2.h>
+
+namespace motion_capture_tracking {
+
+// Converts cloud point by point into the (deprecated) PointCloud message.
+inline void toPointCloud(
+  const pcl::PointCloud<pcl::PointXYZ>& cloud,
+  sensor_msgs::PointCloud& msg)
+{
+  msg.points.resize(cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    const pcl::PointXYZ& point = cloud[i];
+    msg.points[i].x = point.x;
+    msg.points[i].y = point.y;
+    msg.points[i].z = point.z;
+  }
+}
+
+// Converts cloud into a PointCloud2 message with a single copy.
+//
+// pcl::PointXYZ is stored as four floats (x, y, z and padding), so the message
+// advertises exactly that layout and the points can be copied as one block.
+inline void toPointCloud2(
+  const pcl::PointCloud<pcl::PointXYZ>& cloud,
+  sensor_msgs::PointCloud2& msg)
+{
+  static_assert(sizeof(pcl::PointXYZ) == 4 * sizeof(float), "unexpected pcl::PointXYZ layout");
+
+  if (msg.fields.size() != 3) {
+    static const char* names[] = {"x", "y", "z"};
+    msg.fields.resize(3);
+    for (size_t i = 0; i < 3; ++i) {
+      msg.fields[i].name = names[i];
+      msg.fields[i].offset = i * sizeof(float);
+      msg.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+      msg.fields[i].count = 1;
+    }
+  }
+  msg.height = 1;
+  msg.width = cloud.size();
+  msg.is_bigendian = false;
+  msg.point_step = sizeof(pcl::PointXYZ);
+  msg.row_step = msg.point_step * msg.width;
+  msg.is_dense = true;
+  msg.data.resize(msg.row_step);
+  if (!cloud.empty()) {
+    std::memcpy(msg.data.data(), cloud.points.data(), msg.data.size());
+  }
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "motion_capture_tracking/frame_source.h"
+
+namespace motion_capture_tracking {
+
+// Plays back point clouds recorded in the cloud_log format, e.g., by
+// libobjecttracker's PointCloudLogger or save_point_clouds_path.
+//
+// With speed 1 frames are paced by their recorded timestamps; other values
+// scale the playback rate and 0 replays the frames as fast as they are
+// consumed. If path does not exist, the rotated files <path>.0000,
+// <path>.0001, ... are played back in order.
+class ReplayFrameSource : public FrameSource
+{
+public:
+  ReplayFrameSource(
+    const std::string& path,
+    double speed);
+
+  // False if no log file could be opened
+  bool valid() const
+  {
+    return m_stream.is_open();
+  }
+
+  virtual bool waitForNextFrame(Frame& frame, bool withPointCloud);
+
+  virtual bool supportsObjectTracking() const
+  {
+    return false;
+  }
+
+private:
+  bool openNextFile();
+
+private:
+  const std::string m_path;
+  const double m_speed;
+  bool m_rotated;
+  size_t m_fileIdx;
+  std::ifstream m_stream;
+
+  bool m_started;
+  uint32_t m_firstMillis;
+  std::chrono::steady_clock::time_point m_startTime;
+};
+
+} // namespace motion_capture_tracking
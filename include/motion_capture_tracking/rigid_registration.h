@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+#include <Eigen/Geometry>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+namespace motion_capture_tracking {
+
+// Point-to-point ICP of a marker configuration against a (cropped) cloud.
+//
+// Markers are matched to their nearest points in the cloud, the rigid
+// transformation between the matches is solved in closed form (Umeyama/Kabsch)
+// and both steps are repeated until the matches no longer change. Every point
+// is matched to one marker at most, so that a missing marker does not pull its
+// neighbor's point towards it; markers left without a point are not solved
+// for.
+class RigidRegistration
+{
+public:
+  struct Result
+  {
+    Eigen::Affine3f transformation;
+    // mean squared distance [m^2] of the markers to their matches, as PCL's
+    // getFitnessScore()
+    float fitness;
+    // number of transformations solved
+    int iterations;
+  };
+
+  virtual ~RigidRegistration()
+  {
+  }
+
+  // Solves at most maxIterations transformations. Returns false if the cloud
+  // has too few points to register.
+  virtual bool align(
+    const pcl::PointCloud<pcl::PointXYZ>& cloud,
+    const Eigen::Affine3f& guess,
+    int maxIterations,
+    Result& result) const = 0;
+
+  // Registration specialized for the number of markers, or nullptr if there
+  // is no specialization for it.
+  static std::unique_ptr<RigidRegistration> create(
+    const pcl::PointCloud<pcl::PointXYZ>& markers);
+};
+
+// Registration of exactly N markers, without any heap allocation.
+//
+// The markers are kept in structure-of-arrays layout, padded to whole SIMD
+// packets, so that a single pass over the cloud compares every point with all
+// markers at once. Padding lanes sit far away and never match.
+template<int N>
+class FixedRigidRegistration : public RigidRegistration
+{
+public:
+  explicit FixedRigidRegistration(const pcl::PointCloud<pcl::PointXYZ>& markers)
+  {
+    for (int i = 0; i < N; ++i) {
+      m_markers.col(i) = markers[i].getVector3fMap();
+    }
+  }
+
+  virtual bool align(
+    const pcl::PointCloud<pcl::PointXYZ>& cloud,
+    const Eigen::Affine3f& guess,
+    int maxIterations,
+    Result& result) const
+  {
+    if (cloud.size() < 3) {
+      return false;
+    }
+
+    Eigen::Affine3f transformation = guess;
+    Packet matches;
+    Packet distances;
+    Packet lastMatches = Packet::Constant(-1);
+    float fitness = 0;
+    int iterations = 0;
+    while (true) {
+      fitness = correspond(transformation, cloud, matches, distances);
+      if ((matches == lastMatches).all() || iterations >= maxIterations) {
+        break;
+      }
+      lastMatches = matches;
+
+      Subset targets;
+      const Subset sources = distinctTargets(transformation, cloud, matches, distances, targets);
+      transformation.matrix() = Eigen::umeyama(sources, targets, false);
+      ++iterations;
+    }
+
+    result.transformation = transformation;
+    result.fitness = fitness;
+    result.iterations = iterations;
+    return true;
+  }
+
+private:
+  static const int PacketSize = 4;
+  static const int Lanes = (N + PacketSize - 1) / PacketSize * PacketSize;
+  typedef Eigen::Array<float, Lanes, 1> Packet;
+  typedef Eigen::Matrix<float, 3, N> Points;
+  // up to N columns, without heap allocation
+  typedef Eigen::Matrix<float, 3, Eigen::Dynamic, 0, 3, N> Subset;
+
+  // Finds the nearest point of every marker; matches holds the point indices
+  // (exact as floats, so that the selection vectorizes), and distances the
+  // squared distances to them. Returns the fitness.
+  float correspond(
+    const Eigen::Affine3f& transformation,
+    const pcl::PointCloud<pcl::PointXYZ>& cloud,
+    Packet& matches,
+    Packet& distances) const
+  {
+    const Points markers = transformation * m_markers;
+    // far away, but squares stay finite
+    Packet x = Packet::Constant(1e15f);
+    Packet y = Packet::Constant(1e15f);
+    Packet z = Packet::Constant(1e15f);
+    x.template head<N>() = markers.row(0).transpose().array();
+    y.template head<N>() = markers.row(1).transpose().array();
+    z.template head<N>() = markers.row(2).transpose().array();
+
+    distances.setConstant(std::numeric_limits<float>::infinity());
+    matches.setZero();
+    for (size_t j = 0; j < cloud.size(); ++j) {
+      const pcl::PointXYZ& point = cloud[j];
+      const Packet distance = (x - point.x).square() + (y - point.y).square() + (z - point.z).square();
+      matches = (distance < distances).select(Packet::Constant(static_cast<float>(j)), matches);
+      distances = distances.min(distance);
+    }
+    return distances.template head<N>().mean();
+  }
+
+  // Whether the match of marker i is also the match of a closer marker (or,
+  // at the same distance, of one before it)
+  static bool shadowed(const Packet& matches, const Packet& distances, int i)
+  {
+    for (int k = 0; k < N; ++k) {
+      if (k != i && matches[k] == matches[i]
+          && (distances[k] < distances[i] || (distances[k] == distances[i] && k < i))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Pairs the markers with distinct points: a marker whose nearest point is
+  // taken by a closer marker gets the nearest point that is not taken, and is
+  // left out if there is none. Returns the paired markers. Markers rarely share
+  // a nearest point, so the scalar search is cheap overall.
+  Subset distinctTargets(
+    const Eigen::Affine3f& transformation,
+    const pcl::PointCloud<pcl::PointXYZ>& cloud,
+    const Packet& matches,
+    const Packet& distances,
+    Subset& targets) const
+  {
+    Subset sources(3, 0);
+    targets.resize(3, 0);
+    bool isShadowed[N];
+    for (int i = 0; i < N; ++i) {
+      isShadowed[i] = shadowed(matches, distances, i);
+      if (!isShadowed[i]) {
+        append(m_markers.col(i), cloud[static_cast<size_t>(matches[i])].getVector3fMap(), sources, targets);
+      }
+    }
+    for (int i = 0; i < N; ++i) {
+      if (!isShadowed[i]) {
+        continue;
+      }
+      const Eigen::Vector3f marker = transformation * m_markers.col(i);
+      float best = std::numeric_limits<float>::infinity();
+      size_t match = 0;
+      for (size_t j = 0; j < cloud.size(); ++j) {
+        const Eigen::Vector3f point = cloud[j].getVector3fMap();
+        const float distance = (point - marker).squaredNorm();
+        if (distance < best && !taken(targets, point)) {
+          best = distance;
+          match = j;
+        }
+      }
+      if (best < std::numeric_limits<float>::infinity()) {
+        append(m_markers.col(i), cloud[match].getVector3fMap(), sources, targets);
+      }
+    }
+    return sources;
+  }
+
+  static bool taken(const Subset& targets, const Eigen::Vector3f& point)
+  {
+    for (int k = 0; k < targets.cols(); ++k) {
+      if (targets.col(k) == point) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void append(
+    const Eigen::Vector3f& source,
+    const Eigen::Vector3f& target,
+    Subset& sources,
+    Subset& targets)
+  {
+    const int idx = sources.cols();
+    sources.conservativeResize(3, idx + 1);
+    targets.conservativeResize(3, idx + 1);
+    sources.col(idx) = source;
+    targets.col(idx) = target;
+  }
+
+private:
+  Points m_markers;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+inline std::unique_ptr<RigidRegistration> RigidRegistration::create(
+  const pcl::PointCloud<pcl::PointXYZ>& markers)
+{
+  std::unique_ptr<RigidRegistration> result;
+  switch (markers.size()) {
+  case 3:
+    result.reset(new FixedRigidRegistration<3>(markers));
+    break;
+  case 4:
+    result.reset(new FixedRigidRegistration<4>(markers));
+    break;
+  case 5:
+    result.reset(new FixedRigidRegistration<5>(markers));
+    break;
+  case 6:
+    result.reset(new FixedRigidRegistration<6>(markers));
+    break;
+  default:
+    break;
+  }
+  return result;
+}
+
+} // namespace motion_capture_tracking
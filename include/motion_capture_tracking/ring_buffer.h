@@ -0,0 +1,286 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace motion_capture_tracking {
+
+// Bounded lock-free ring buffer between a single producer and a single
+// consumer.
+//
+// All slots are allocated up front. Elements are exchanged by swapping, so the
+// producer gets back a recycled element on every push and no allocations happen
+// on the data path once every slot has been used once.
+//
+// When the ring is full the producer either drops the oldest element
+// (OverflowPolicy::DropOldest) or waits until the consumer made room
+// (OverflowPolicy::Block). Dropping is implemented by letting the producer act
+// as a second consumer, which is why the slots carry sequence numbers (as in
+// D. Vyukov's bounded MPMC queue) instead of relying on head/tail only.
+//
+// The mutex and condition variables are only used to put an idle thread to
+// sleep; they are never taken while the other side is busy.
+template<typename T>
+class RingBuffer
+{
+public:
+  enum class OverflowPolicy
+  {
+    DropOldest,
+    Block,
+  };
+
+  RingBuffer(
+    size_t capacity,
+    OverflowPolicy policy)
+    : m_capacity(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity))
+    , m_mask(m_capacity - 1)
+    , m_slots(new Slot[m_capacity])
+    , m_policy(policy)
+    , m_head(0)
+    , m_tail(0)
+    , m_pushed(0)
+    , m_dropped(0)
+    , m_blocked(0)
+    , m_closed(false)
+    , m_consumerWaiting(0)
+    , m_producerWaiting(0)
+  {
+    for (size_t i = 0; i < m_capacity; ++i) {
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  // Calls f on every preallocated element, e.g., to reserve memory. Must not
+  // be called once the ring is in use.
+  template<class F>
+  void initialize(F f)
+  {
+    for (size_t i = 0; i < m_capacity; ++i) {
+      f(m_slots[i].data);
+    }
+    f(m_overflow);
+  }
+
+  // Producer only. Swaps item into the ring; afterwards item holds a recycled
+  // element. Returns false if the ring has been closed.
+  bool push(T& item)
+  {
+    bool blocked = false;
+    while (!m_closed.load(std::memory_order_relaxed)) {
+      if (tryPush(item)) {
+        wakeUp(m_consumerWaiting, m_notEmpty);
+        return true;
+      }
+      if (m_policy == OverflowPolicy::DropOldest) {
+        if (tryPop(m_overflow)) {
+          m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+      } else {
+        if (!blocked) {
+          m_blocked.fetch_add(1, std::memory_order_relaxed);
+          blocked = true;
+        }
+        waitFor(m_producerWaiting, m_notFull, std::chrono::milliseconds(10),
+          [this] { return !full() || m_closed.load(); });
+      }
+    }
+    return false;
+  }
+
+  // Consumer only. Swaps the oldest element into item without waiting.
+  bool pop(T& item)
+  {
+    if (tryPop(item)) {
+      wakeUp(m_producerWaiting, m_notFull);
+      return true;
+    }
+    return false;
+  }
+
+  // Consumer only. Like pop(), but waits up to timeout for an element.
+  template<class Rep, class Period>
+  bool pop(T& item, const std::chrono::duration<Rep, Period>& timeout)
+  {
+    bool popped = tryPop(item);
+    if (!popped) {
+      waitFor(m_consumerWaiting, m_notEmpty, timeout,
+        [&] { popped = tryPop(item); return popped || m_closed.load(); });
+    }
+    if (popped) {
+      wakeUp(m_producerWaiting, m_notFull);
+    }
+    return popped;
+  }
+
+  // Wakes up both sides; subsequent pushes fail. Elements still in the ring
+  // can be popped.
+  void close()
+  {
+    m_closed = true;
+    {
+      std::lock_guard<std::mutex> lock(m_waitMutex);
+    }
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+  }
+
+  bool closed() const
+  {
+    return m_closed.load(std::memory_order_relaxed);
+  }
+
+  size_t capacity() const
+  {
+    return m_capacity;
+  }
+
+  size_t size() const
+  {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    return head >= tail ? head - tail : 0;
+  }
+
+  // Number of elements pushed successfully
+  uint64_t numPushed() const
+  {
+    return m_pushed.load(std::memory_order_relaxed);
+  }
+
+  // Number of elements discarded by OverflowPolicy::DropOldest
+  uint64_t numDropped() const
+  {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+  // Number of pushes that had to wait for room (OverflowPolicy::Block)
+  uint64_t numBlocked() const
+  {
+    return m_blocked.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  static size_t roundUpToPowerOfTwo(size_t value)
+  {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  bool full() const
+  {
+    return size() >= m_capacity;
+  }
+
+  // There is only one producer, so the head does not need a CAS.
+  bool tryPush(T& item)
+  {
+    const size_t pos = m_head.load(std::memory_order_relaxed);
+    Slot& slot = m_slots[pos & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != pos) {
+      return false;
+    }
+    m_head.store(pos + 1, std::memory_order_relaxed);
+    using std::swap;
+    swap(slot.data, item);
+    slot.sequence.store(pos + 1, std::memory_order_release);
+    m_pushed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Called by the consumer and, to drop the oldest element, by the producer.
+  bool tryPop(T& item)
+  {
+    size_t pos = m_tail.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = m_slots[pos & m_mask];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          using std::swap;
+          swap(slot.data, item);
+          slot.sequence.store(pos + m_capacity, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // The fences pair up with the ones in waitFor(): either the sleeping side
+  // sees the new state in its predicate, or the waking side sees the waiter.
+  void wakeUp(std::atomic<int>& waiting, std::condition_variable& cv)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed) > 0) {
+      {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+      }
+      cv.notify_one();
+    }
+  }
+
+  template<class Rep, class Period, class Predicate>
+  void waitFor(
+    std::atomic<int>& waiting,
+    std::condition_variable& cv,
+    const std::chrono::duration<Rep, Period>& timeout,
+    Predicate predicate)
+  {
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    waiting.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv.wait_for(lock, timeout, predicate);
+    waiting.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+private:
+  const size_t m_capacity;
+  const size_t m_mask;
+  std::unique_ptr<Slot[]> m_slots;
+  const OverflowPolicy m_policy;
+
+  // head and tail are written by different threads; keep them on separate
+  // cache lines
+  std::atomic<size_t> m_head;
+  char m_padding[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> m_tail;
+
+  std::atomic<uint64_t> m_pushed;
+  std::atomic<uint64_t> m_dropped;
+  std::atomic<uint64_t> m_blocked;
+  std::atomic<bool> m_closed;
+
+  // receives elements dropped by the producer; owned by the producer thread
+  T m_overflow;
+
+  std::mutex m_waitMutex;
+  std::condition_variable m_notEmpty;
+  std::condition_variable m_notFull;
+  std::atomic<int> m_consumerWaiting;
+  std::atomic<int> m_producerWaiting;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace motion_capture_tracking {
+
+// Layout of the POSIX shared memory segment the poses of every frame are
+// written to by SharedPoseWriter, and read from by SharedPoseReader. Writer
+// and readers run on the same host, so all fields are native-endian.
+//
+// The segment is guarded by a seqlock: the writer makes sequence odd before it
+// touches the frame and even again once it is done, so a reader that sees the
+// same even sequence before and after copying the frame got a consistent one.
+// The writer never waits for readers.
+namespace shared_poses {
+
+const uint32_t Magic = 0x5043544d; // "MTCP"
+const uint32_t Version = 2;
+const size_t NameSize = 32;
+
+struct Pose
+{
+  // index in the node's ~object_names
+  uint32_t id;
+  // whether the object was found in this frame; otherwise its last pose
+  uint8_t valid;
+  // whether the pose was extrapolated with the last velocity instead of
+  // measured, while the tracker is degraded; valid then, too
+  uint8_t extrapolated;
+  uint16_t reserved;
+  float position[3];
+  // x, y, z, w
+  float orientation[4];
+  // null-terminated, truncated
+  char name[NameSize];
+};
+
+struct Header
+{
+  // Magic while the writer is alive; 0 once it closed the segment
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  // number of poses the segment has room for
+  uint32_t capacity;
+  uint32_t poseSize;
+  std::atomic<uint64_t> sequence;
+
+  // the frame, valid if sequence is even
+  uint64_t frameId;
+  // mocap timestamp [us], 0 if not provided
+  uint64_t timestamp;
+  // ROS time the poses are stamped with [ns]
+  int64_t stamp;
+  uint32_t numPoses;
+  uint32_t reserved;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+  "the seqlock requires lock-free atomics, which also work across processes");
+static_assert(sizeof(Header) % alignof(Pose) == 0, "poses follow the header");
+
+inline size_t segmentSize(size_t capacity)
+{
+  return sizeof(Header) + capacity * sizeof(Pose);
+}
+
+inline Pose* poses(Header* header)
+{
+  return reinterpret_cast<Pose*>(header + 1);
+}
+
+inline const Pose* poses(const Header* header)
+{
+  return reinterpret_cast<const Pose*>(header + 1);
+}
+
+} // namespace shared_poses
+
+} // namespace motion_capture_tracking
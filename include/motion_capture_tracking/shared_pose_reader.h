@@ -0,0 +1,163 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "motion_capture_tracking/shared_pose_layout.h"
+
+namespace motion_capture_tracking {
+
+// Reads the poses the node writes to shared memory (see shared_memory_name).
+// Header-only and free of ROS, for controllers on the same host:
+//
+//   SharedPoseReader reader;
+//   SharedPoseReader::Snapshot snapshot;
+//   uint64_t last = 0;
+//   while (true) {
+//     if (!reader.isOpen() && !reader.open("/motion_capture_tracking")) {
+//       continue; // not there yet
+//     }
+//     if (reader.sequence() == last) {
+//       continue; // no new frame
+//     }
+//     if (!reader.read(snapshot)) {
+//       reader.close(); // the node has exited or restarted
+//       continue;
+//     }
+//     last = snapshot.sequence;
+//     ...
+//   }
+//
+// read() never blocks the writer, and only allocates the first time for a
+// snapshot.
+class SharedPoseReader
+{
+public:
+  struct Snapshot
+  {
+    uint64_t sequence;
+    uint64_t frameId;
+    // mocap timestamp [us], 0 if not provided
+    uint64_t timestamp;
+    // ROS time [ns]
+    int64_t stamp;
+    std::vector<shared_poses::Pose> poses;
+  };
+
+  SharedPoseReader()
+    : m_header(nullptr)
+    , m_size(0)
+  {
+  }
+
+  ~SharedPoseReader()
+  {
+    close();
+  }
+
+  SharedPoseReader(const SharedPoseReader&) = delete;
+  SharedPoseReader& operator=(const SharedPoseReader&) = delete;
+
+  // Maps the segment; returns false if it does not exist (yet) or is not
+  // compatible.
+  bool open(const std::string& name)
+  {
+    close();
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (::fstat(fd, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(shared_poses::Header))) {
+      memory = ::mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+      return false;
+    }
+    m_header = static_cast<const shared_poses::Header*>(memory);
+    m_size = status.st_size;
+    if (m_header->magic.load(std::memory_order_acquire) != shared_poses::Magic
+        || m_header->version != shared_poses::Version
+        || m_header->poseSize != sizeof(shared_poses::Pose)
+        || shared_poses::segmentSize(m_header->capacity) > m_size) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+    if (m_header) {
+      ::munmap(const_cast<shared_poses::Header*>(m_header), m_size);
+      m_header = nullptr;
+      m_size = 0;
+    }
+  }
+
+  bool isOpen() const
+  {
+    return m_header != nullptr;
+  }
+
+  // Changes with every frame written; requires isOpen()
+  uint64_t sequence() const
+  {
+    return m_header->sequence.load(std::memory_order_acquire);
+  }
+
+  // Copies the latest frame, retrying while the writer is in the middle of
+  // it. Returns false once the writer has closed the segment, or if it does
+  // not finish a frame (e.g., it crashed); the segment then needs to be opened
+  // again. Requires isOpen().
+  bool read(Snapshot& snapshot)
+  {
+    const shared_poses::Pose* poses = shared_poses::poses(m_header);
+    if (snapshot.poses.capacity() < m_header->capacity) {
+      snapshot.poses.reserve(m_header->capacity);
+    }
+    // The writer only holds the sequence odd while it copies the poses of a
+    // frame, in the order of a microsecond per hundred poses. The attempts,
+    // milliseconds of spinning, thus only run out if the writer died in the
+    // middle of a frame, or was preempted for that long.
+    for (int attempt = 0; attempt < 1000000; ++attempt) {
+      if (m_header->magic.load(std::memory_order_acquire) != shared_poses::Magic) {
+        return false;
+      }
+      const uint64_t before = m_header->sequence.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;
+      }
+      snapshot.frameId = m_header->frameId;
+      snapshot.timestamp = m_header->timestamp;
+      snapshot.stamp = m_header->stamp;
+      const uint32_t numPoses = m_header->numPoses;
+      if (numPoses <= m_header->capacity) {
+        snapshot.poses.resize(numPoses);
+        std::memcpy(snapshot.poses.data(), poses, numPoses * sizeof(shared_poses::Pose));
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (m_header->sequence.load(std::memory_order_relaxed) == before && numPoses <= m_header->capacity) {
+        snapshot.sequence = before;
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  const shared_poses::Header* m_header;
+  size_t m_size;
+};
+
+} // namespace motion_capture_tracking
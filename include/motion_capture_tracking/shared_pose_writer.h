@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <Eigen/Geometry>
+#include <ros/time.h>
+
+#include "motion_capture_tracking/shared_pose_layout.h"
+
+namespace motion_capture_tracking {
+
+// Writes the poses of every frame to a POSIX shared memory segment, for
+// consumers on the same host that cannot afford the latency of a ROS
+// transport; see SharedPoseReader and shared_pose_layout.h.
+//
+// A frame is written in place between begin() and commit(), under the
+// seqlock, so neither copies nor allocates, and never waits for a reader.
+// Readers spin while a frame is written, so the calls should follow each
+// other without any other work in between.
+// Poses beyond the capacity of the segment are dropped.
+class SharedPoseWriter
+{
+public:
+  SharedPoseWriter();
+
+  // Marks the segment as closed and removes it.
+  ~SharedPoseWriter();
+
+  SharedPoseWriter(const SharedPoseWriter&) = delete;
+  SharedPoseWriter& operator=(const SharedPoseWriter&) = delete;
+
+  // Creates the segment name (e.g., "/motion_capture_tracking"), replacing an
+  // existing one, with room for capacity poses. Returns false on failure.
+  bool open(const std::string& name, size_t capacity);
+
+  void begin(uint64_t frameId, uint64_t timestamp, const ros::Time& stamp);
+
+  void add(
+    uint32_t id,
+    const std::string& name,
+    const Eigen::Vector3f& position,
+    const Eigen::Quaternionf& rotation,
+    bool valid,
+    bool extrapolated);
+
+  void commit();
+
+  // Number of poses dropped since they did not fit; may be queried from any
+  // thread
+  uint64_t numDropped() const
+  {
+    return m_numDropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::string m_name;
+  shared_poses::Header* m_header;
+  size_t m_size;
+  uint32_t m_numPoses;
+  std::atomic<uint64_t> m_numDropped;
+};
+
+} // namespace motion_capture_tracking
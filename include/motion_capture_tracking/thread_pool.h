@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace motion_capture_tracking {
+
+// Fixed-size pool of persistent worker threads with work stealing.
+//
+// run() splits the task indices into one contiguous range per thread (the
+// calling thread is one of them). Each thread works through its own range from
+// the front and, once it runs dry, steals single tasks from the back of the
+// other ranges. Ranges are packed into a single atomic word, so neither taking
+// nor stealing a task needs a lock.
+class ThreadPool
+{
+public:
+  // numThreads includes the thread calling run(); numThreads - 1 workers are
+  // started.
+  explicit ThreadPool(size_t numThreads);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t numThreads() const
+  {
+    return m_numThreads;
+  }
+
+  // Calls task(i) for every i in [0, numTasks) and returns once all calls have
+  // finished. Only one thread may call run() at a time.
+  template<class Task>
+  void run(size_t numTasks, Task& task)
+  {
+    runImpl(numTasks, &task, [](void* context, size_t taskIdx) {
+      (*static_cast<Task*>(context))(taskIdx);
+    });
+  }
+
+private:
+  typedef void (*TaskFunction)(void* context, size_t taskIdx);
+
+  // padded to a cache line each, so threads do not contend on neighbours
+  struct Range
+  {
+    // begin in the upper, end in the lower 32 bit
+    std::atomic<uint64_t> value;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  void runImpl(size_t numTasks, void* context, TaskFunction function);
+
+  void workerLoop(size_t threadIdx);
+
+  void work(size_t threadIdx);
+
+  bool takeOwn(size_t threadIdx, size_t& taskIdx);
+
+  bool steal(size_t threadIdx, size_t& taskIdx);
+
+private:
+  const size_t m_numThreads;
+  std::unique_ptr<Range[]> m_ranges;
+  std::vector<std::thread> m_workers;
+
+  void* m_context;
+  TaskFunction m_function;
+  std::atomic<size_t> m_pending;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wakeUp;
+  std::condition_variable m_done;
+  uint64_t m_generation;
+  bool m_stop;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace motion_capture_tracking {
+
+// Latency tracing of the stages of every frame, for chrome://tracing or
+// https://ui.perfetto.dev.
+//
+// A TraceScope records the time from its construction to its destruction.
+// Every thread records into its own ring of events, set up on its first event,
+// so recording takes no lock and does not allocate; once a ring is full, the
+// oldest events are overwritten. Tracing is process-wide. While it is
+// disabled, a TraceScope costs one relaxed atomic load.
+namespace detail {
+
+extern std::atomic<bool> tracingEnabled;
+
+void recordTraceEvent(const char* name, const char* argName, int64_t arg, uint64_t begin, uint64_t end);
+
+} // namespace detail
+
+// Starts recording, with room for eventsPerThread events per thread. Threads
+// that already recorded keep the size of their ring.
+void enableTracing(size_t eventsPerThread);
+
+// Stops recording; the events recorded so far can still be written.
+void disableTracing();
+
+inline bool tracingEnabled()
+{
+  return detail::tracingEnabled.load(std::memory_order_relaxed);
+}
+
+// Names the calling thread in traces. name must be a string literal.
+void setTraceThreadName(const char* name);
+
+// Writes the events of all threads as Chrome trace JSON, while recording goes
+// on. Returns false if the file could not be written.
+bool writeTrace(const std::string& path, size_t& numEvents);
+
+// Records a stage. name and argName must be string literals without quotes or
+// backslashes; the argument (e.g., a frame id or object index) is only written
+// if argName is set.
+class TraceScope
+{
+public:
+  explicit TraceScope(const char* name, const char* argName = nullptr, int64_t arg = 0)
+    : m_name(name)
+    , m_argName(argName)
+    , m_arg(arg)
+    , m_begin(tracingEnabled() ? now() : 0)
+  {
+  }
+
+  ~TraceScope()
+  {
+    if (m_begin != 0) {
+      detail::recordTraceEvent(m_name, m_argName, m_arg, m_begin, now());
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  static uint64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+private:
+  const char* m_name;
+  const char* m_argName;
+  int64_t m_arg;
+  // 0 if not recording
+  uint64_t m_begin;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <Eigen/Geometry>
+
+namespace motion_capture_tracking {
+
+// Configuration and last pose of an object tracked by ParallelObjectTracker.
+// Mirrors libobjecttracker::Object, but also exposes the configuration
+// indices.
+class TrackedObject
+{
+public:
+  TrackedObject(
+    size_t markerConfigurationIdx,
+    size_t dynamicsConfigurationIdx,
+    const Eigen::Affine3f& initialTransformation,
+    const std::string& name,
+    int priority = 0)
+    : m_markerConfigurationIdx(markerConfigurationIdx)
+    , m_dynamicsConfigurationIdx(dynamicsConfigurationIdx)
+    , m_transformation(initialTransformation)
+    , m_lastTransformationValid(false)
+    , m_lastTransformationExtrapolated(false)
+    , m_name(name)
+    , m_priority(priority)
+  {
+  }
+
+  size_t markerConfigurationIdx() const
+  {
+    return m_markerConfigurationIdx;
+  }
+
+  size_t dynamicsConfigurationIdx() const
+  {
+    return m_dynamicsConfigurationIdx;
+  }
+
+  // last valid pose, or the initial one
+  const Eigen::Affine3f& transformation() const
+  {
+    return m_transformation;
+  }
+
+  // whether the object was found in the last frame
+  bool lastTransformationValid() const
+  {
+    return m_lastTransformationValid;
+  }
+
+  // whether the last pose was extrapolated with the last velocity instead of
+  // solved; it is valid then, too
+  bool lastTransformationExtrapolated() const
+  {
+    return m_lastTransformationExtrapolated;
+  }
+
+  const std::string& name() const
+  {
+    return m_name;
+  }
+
+  // higher is more important, when the tracker runs out of time
+  int priority() const
+  {
+    return m_priority;
+  }
+
+  void setTransformation(const Eigen::Affine3f& transformation, bool valid, bool extrapolated = false)
+  {
+    m_transformation = transformation;
+    m_lastTransformationValid = valid;
+    m_lastTransformationExtrapolated = extrapolated;
+  }
+
+private:
+  size_t m_markerConfigurationIdx;
+  size_t m_dynamicsConfigurationIdx;
+  Eigen::Affine3f m_transformation;
+  bool m_lastTransformationValid;
+  bool m_lastTransformationExtrapolated;
+  std::string m_name;
+  int m_priority;
+};
+
+} // namespace motion_capture_tracking
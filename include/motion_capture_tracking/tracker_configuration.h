@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <XmlRpcValue.h>
+#include <libobjecttracker/object_tracker.h>
+
+#include "motion_capture_tracking/tracked_object.h"
+
+namespace motion_capture_tracking {
+
+// Everything a ParallelObjectTracker is constructed from, as configured by the
+// numDynamicsConfigurations, dynamicsConfigurations, numMarkerConfigurations,
+// markerConfigurations, and objects parameters.
+//
+// The parameters are fetched from the parameter server at once, as a single
+// XmlRpcValue, and parsed locally.
+struct TrackerConfiguration
+{
+  std::vector<libobjecttracker::DynamicsConfiguration> dynamicsConfigurations;
+  std::vector<libobjecttracker::MarkerConfiguration> markerConfigurations;
+  std::vector<TrackedObject> objects;
+
+  // Parses the configuration from params, the node's private namespace.
+  // Returns false and logs an error if it is incomplete or malformed.
+  bool parse(XmlRpc::XmlRpcValue& params);
+};
+
+} // namespace motion_capture_tracking
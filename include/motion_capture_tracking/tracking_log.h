@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace motion_capture_tracking {
+
+// Tracking log files, holding the output of the tracker for every frame, laid
+// out so that analysis tools can mmap() them and scan single fields of hours
+// of data without parsing anything.
+//
+// A file starts with a FileHeader and the names of the object slots, padded
+// to headerSize. It is followed by blocks of blockSize bytes each, so block b
+// starts at headerSize + b * blockSize. A block holds up to framesPerBlock
+// frames, stored column by column:
+//
+//   BlockHeader
+//   uint64   frame id              [framesPerBlock]
+//   uint64   mocap timestamp [us]  [framesPerBlock]
+//   int64    ROS stamp [ns]        [framesPerBlock]
+//   uint32   number of markers     [framesPerBlock]
+//   float32  position x, y, z      [framesPerBlock][capacity][3]
+//   float32  orientation x, y, z, w [framesPerBlock][capacity][4]
+//   float32  fitness [m^2]         [framesPerBlock][capacity]
+//   uint16   ICP iterations        [framesPerBlock][capacity]
+//   uint8    valid                 [framesPerBlock][capacity]
+//   uint8    extrapolated          [framesPerBlock][capacity]
+//
+// with every column starting at the offset given by layout(). Objects are
+// stored in the slot of their id in ~object_names. Slots without an object
+// in a frame are not valid and have a NaN pose; the fitness is NaN if it is
+// not known. Extrapolated poses, predicted by a degraded tracker, are valid,
+// too. Only the last block may hold fewer than framesPerBlock frames, as
+// given by its BlockHeader. All values are in host byte order.
+namespace tracking_log {
+
+const char Magic[4] = {'M', 'C', 'T', 'L'};
+const uint32_t Version = 2;
+const size_t NameSize = 32;
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  // number of object slots
+  uint32_t capacity;
+  uint32_t framesPerBlock;
+  uint64_t headerSize;
+  uint64_t blockSize;
+  // followed by capacity null-terminated names of NameSize bytes
+};
+
+struct BlockHeader
+{
+  uint32_t numFrames;
+  uint32_t reserved;
+};
+
+// offsets of the columns within a block [bytes]
+struct Layout
+{
+  size_t frameId;
+  size_t timestamp;
+  size_t stamp;
+  size_t numMarkers;
+  size_t position;
+  size_t orientation;
+  size_t fitness;
+  size_t iterations;
+  size_t valid;
+  size_t extrapolated;
+  size_t blockSize;
+  size_t headerSize;
+};
+
+inline size_t alignUp(size_t size, size_t alignment)
+{
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+inline Layout layout(uint32_t capacity, uint32_t framesPerBlock)
+{
+  // columns on cache lines, blocks on pages
+  const size_t lineSize = 64;
+  const size_t pageSize = 4096;
+  const size_t numFrames = framesPerBlock;
+  const size_t numSlots = numFrames * capacity;
+  Layout result;
+  size_t offset = alignUp(sizeof(BlockHeader), lineSize);
+  result.frameId = offset;
+  offset = alignUp(offset + numFrames * sizeof(uint64_t), lineSize);
+  result.timestamp = offset;
+  offset = alignUp(offset + numFrames * sizeof(uint64_t), lineSize);
+  result.stamp = offset;
+  offset = alignUp(offset + numFrames * sizeof(int64_t), lineSize);
+  result.numMarkers = offset;
+  offset = alignUp(offset + numFrames * sizeof(uint32_t), lineSize);
+  result.position = offset;
+  offset = alignUp(offset + numSlots * 3 * sizeof(float), lineSize);
+  result.orientation = offset;
+  offset = alignUp(offset + numSlots * 4 * sizeof(float), lineSize);
+  result.fitness = offset;
+  offset = alignUp(offset + numSlots * sizeof(float), lineSize);
+  result.iterations = offset;
+  offset = alignUp(offset + numSlots * sizeof(uint16_t), lineSize);
+  result.valid = offset;
+  offset = alignUp(offset + numSlots * sizeof(uint8_t), lineSize);
+  result.extrapolated = offset;
+  offset += numSlots * sizeof(uint8_t);
+  result.blockSize = alignUp(offset, pageSize);
+  result.headerSize = alignUp(sizeof(FileHeader) + capacity * NameSize, pageSize);
+  return result;
+}
+
+// Column at offset of the block at data (e.g., the mapped file)
+template<typename T>
+const T* column(const char* data, const FileHeader& header, size_t block, size_t offset)
+{
+  return reinterpret_cast<const T*>(data + header.headerSize + block * header.blockSize + offset);
+}
+
+// Whether data, of size bytes, starts with a header of this version
+inline bool valid(const char* data, size_t size)
+{
+  if (size < sizeof(FileHeader)) {
+    return false;
+  }
+  FileHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  const Layout expected = layout(header.capacity, header.framesPerBlock);
+  return std::memcmp(header.magic, Magic, sizeof(Magic)) == 0
+    && header.version == Version
+    && header.headerSize == expected.headerSize
+    && header.blockSize == expected.blockSize
+    && size >= header.headerSize;
+}
+
+} // namespace tracking_log
+} // namespace motion_capture_tracking
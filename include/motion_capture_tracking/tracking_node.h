@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/Header.h>
+
+#include <libobjecttracker/cloudlog.hpp>
+
+#include "motion_capture_tracking/AddMarkerConfiguration.h"
+#include "motion_capture_tracking/AddObject.h"
+#include "motion_capture_tracking/async_cloud_logger.h"
+#include "motion_capture_tracking/async_tracking_logger.h"
+#include "motion_capture_tracking/clock_mapper.h"
+#include "motion_capture_tracking/frame.h"
+#include "motion_capture_tracking/frame_acquisition.h"
+#include "motion_capture_tracking/frame_monitor.h"
+#include "motion_capture_tracking/marker_filter.h"
+#include "motion_capture_tracking/merged_frame_source.h"
+#include "motion_capture_tracking/metrics.h"
+#include "motion_capture_tracking/NamedPoseArray.h"
+#include "motion_capture_tracking/parallel_object_tracker.h"
+#include "motion_capture_tracking/RemoveObject.h"
+#include "motion_capture_tracking/ResetObject.h"
+#include "motion_capture_tracking/shared_pose_writer.h"
+#include "motion_capture_tracking/transform_batch.h"
+#include "motion_capture_tracking/WriteTrace.h"
+
+namespace motion_capture_tracking {
+
+// The tracking pipeline, shared by the standalone node and the nodelet.
+//
+// Frames are acquired on a background thread by a FrameAcquisition and
+// handed to run(). Every frame's objects are either taken from the motion
+// capture system or tracked by a ParallelObjectTracker (on the markers left
+// by an optional MarkerFilter), and then published on
+// /tf and ~poses along with the (decimated) point cloud on ~pointCloud, and
+// optionally written to shared memory by a SharedPoseWriter and to a tracking
+// log by an AsyncTrackingLogger.
+//
+// run() never blocks on the motion capture system itself, and no ROS callbacks
+// are processed on its thread; the node uses a ros::AsyncSpinner for them. A
+// FrameMonitor reports gaps in the stream, and declares it lost if no frame
+// arrives for stream_timeout_factor nominal frame intervals.
+//
+// Point clouds and poses are published as shared pointers, so that nodelets
+// in the same manager receive them without serialization or copies. A message
+// is only reused for the next frame once no subscriber holds on to it.
+//
+// Tracked objects can be added, removed, and reset through services at
+// runtime. The service callbacks hand their change to run(), which applies it
+// between two frames, and wait for it. Every object name keeps its id in
+// ~object_names, also after the object was removed.
+//
+// The stages of every frame can be traced (see tracer.h), and written by the
+// ~write_trace service.
+class TrackingNode
+{
+public:
+  // n is used for global topics (/tf, /diagnostics), nl for the parameters
+  // and the node's own topics.
+  TrackingNode(
+    const ros::NodeHandle& n,
+    const ros::NodeHandle& nl);
+
+  ~TrackingNode();
+
+  // Reads the parameters and connects to the motion capture system. Returns
+  // false if the configuration is invalid.
+  bool initialize();
+
+  // Tracks frames until stop() is called, ROS shuts down, or a replay ends.
+  void run();
+
+  // Makes run() return after the current frame. May be called from any
+  // thread.
+  void stop();
+
+private:
+  bool needPointCloud() const;
+
+  void checkStream();
+
+  void processFrame(Frame& frame);
+
+  void publishPointCloud(const Frame& frame, const ros::Time& stamp);
+
+  // Writes the poses of the frame, after processFrame() gathered them
+  void writeSharedPoses(const Frame& frame, uint64_t timestamp, const ros::Time& stamp);
+
+  void addPose(
+    uint32_t id,
+    const Eigen::Vector3f& position,
+    const Eigen::Quaternionf& rotation,
+    bool extrapolated);
+
+  void printSummary();
+
+  // Runs command on the thread of run() before the next frame, and waits for
+  // it. Returns false if it did not get there within a second.
+  bool runBetweenFrames(const std::function<void()>& command);
+
+  // Called by run() between frames
+  void runCommands();
+
+  bool addMarkerConfiguration(
+    AddMarkerConfiguration::Request& req,
+    AddMarkerConfiguration::Response& res);
+
+  bool addObject(AddObject::Request& req, AddObject::Response& res);
+
+  bool removeObject(RemoveObject::Request& req, RemoveObject::Response& res);
+
+  bool resetObject(ResetObject::Request& req, ResetObject::Response& res);
+
+  bool writeTrace(WriteTrace::Request& req, WriteTrace::Response& res);
+
+  // index of the tracked object, or -1
+  int findObject(const std::string& name) const;
+
+  // id of the name in m_objectNames, which is appended if new
+  uint32_t objectId(const std::string& name);
+
+  // Hands a copy of m_objectNames to publishObjectNames(); called by run(),
+  // which thus never waits for the parameter server
+  void objectNamesChanged();
+
+  // Sets ~object_names if they changed; called on the spinner threads
+  void publishObjectNames();
+
+  void publishObjectNamesTimer(const ros::WallTimerEvent& event);
+
+private:
+  ros::NodeHandle m_n;
+  ros::NodeHandle m_nl;
+  std::atomic<bool> m_stop;
+
+  std::unique_ptr<FrameAcquisition> m_acquisition;
+  // owned by m_acquisition, if motion_capture_sources are merged
+  MergedFrameSource* m_mergedSource;
+  FrameMonitor m_frameMonitor;
+  bool m_useLibObjectTracker;
+  bool m_replay;
+  uint64_t m_lastDropped;
+  uint64_t m_lastTimestamp;
+  ros::Time m_lastArrivalTime;
+
+  // point cloud output
+  ros::Publisher m_pubPointCloud;
+  bool m_usePointCloud2;
+  int m_pointCloudDecimation;
+  std_msgs::Header m_pointCloudHeader;
+  sensor_msgs::PointCloudPtr m_msgPointCloud;
+  sensor_msgs::PointCloud2Ptr m_msgPointCloud2;
+  std::unique_ptr<libobjecttracker::PointCloudLogger> m_pointCloudLogger;
+  std::unique_ptr<AsyncCloudLogger> m_asyncCloudLogger;
+
+  std::unique_ptr<MarkerFilter> m_markerFilter;
+  std::unique_ptr<ParallelObjectTracker> m_tracker;
+  ClockMapper m_clockMapper;
+  double m_mocapLatency;
+  // replays are stamped by their recorded timestamps, relative to the arrival
+  // of the first frame
+  ros::Time m_replayStartStamp;
+  uint64_t m_replayStartTimestamp;
+
+  // pose output
+  bool m_publishTf;
+  ros::Publisher m_pubTf;
+  TransformBatch m_transforms;
+  bool m_publishPoses;
+  ros::Publisher m_pubPoses;
+  uint32_t m_posesSeq;
+  NamedPoseArrayPtr m_msgPoses;
+  std::unique_ptr<SharedPoseWriter> m_sharedPoses;
+  std::unique_ptr<AsyncTrackingLogger> m_trackingLogger;
+  std::vector<std::string> m_objectNames;
+  // of every tracked object
+  std::vector<uint32_t> m_objectIds;
+  // motionCapture mode only; rigid bodies get their id when first seen
+  std::map<std::string, uint32_t> m_rigidBodyIds;
+  // ids of the rigid bodies of the current frame, by their index in it
+  std::vector<uint32_t> m_frameRigidBodyIds;
+  // names waiting for publishObjectNames(), which holds the second mutex
+  // while it sets them, so that they reach the parameter server in order
+  std::mutex m_changedObjectNamesMutex;
+  std::vector<std::string> m_changedObjectNames;
+  bool m_objectNamesChanged;
+  std::mutex m_publishObjectNamesMutex;
+  ros::WallTimer m_objectNamesTimer;
+
+  // changes of the tracked objects, waiting for run()
+  struct Command
+  {
+    std::function<void()> apply;
+    bool done;
+  };
+  std::mutex m_commandsMutex;
+  std::condition_variable m_commandsCondition;
+  std::vector<Command*> m_commands;
+  // shut down before the above
+  std::vector<ros::ServiceServer> m_services;
+
+  // instrumentation; the histograms are owned by m_metrics
+  Metrics m_metrics;
+  Histogram* m_frameIntervalHistogram;
+  Histogram* m_acquisitionHistogram;
+  Histogram* m_queueHistogram;
+  Histogram* m_filterHistogram;
+  Histogram* m_trackerHistogram;
+  Histogram* m_publishHistogram;
+  Histogram* m_latencyHistogram;
+  Histogram* m_markersHistogram;
+  Histogram* m_validObjectsHistogram;
+  Counter* m_framesCounter;
+  Counter* m_frameGapsCounter;
+  Counter* m_streamLossesCounter;
+  Counter* m_tfSkippedCounter;
+  Gauge* m_nominalIntervalGauge;
+  Gauge* m_clockOffsetGauge;
+  Gauge* m_clockDriftGauge;
+  Gauge* m_receptionDelayGauge;
+  Gauge* m_clockResetsGauge;
+  // only available in builds with COUNT_ALLOCATIONS
+  Histogram* m_allocationsHistogram;
+  Histogram* m_trackerAllocationsHistogram;
+  // written on shutdown, and by ~write_trace without a path
+  std::string m_tracePath;
+  // summary of a replay; unlike the metrics, this is never reset
+  Histogram m_replayTrackerHistogram;
+  Stopwatch m_replayStopwatch;
+  // reads all of the above, hence destroyed first
+  std::unique_ptr<MetricsReporter> m_metricsReporter;
+};
+
+} // namespace motion_capture_tracking
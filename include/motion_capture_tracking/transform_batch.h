@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <ros/time.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <tf2_msgs/TFMessage.h>
+
+namespace motion_capture_tracking {
+
+// Collects the transforms of a frame into a single tf2_msgs/TFMessage, as
+// tf2_ros::TransformBroadcaster would send them, without allocating.
+//
+// Every object has a slot holding its TransformStamped, frame ids included.
+// add() swaps the slot into the message, which only moves the strings, and
+// clear() swaps it back once the message has been published. After the first
+// frames, neither allocates.
+//
+// The slot thus also holds the transform last sent for the object. With
+// change thresholds, a pose that is within them of that transform is skipped,
+// unless it was sent longer than keepAlivePeriod ago, so that objects at rest
+// are only sent at the keep-alive rate.
+class TransformBatch
+{
+public:
+  explicit TransformBatch(const std::string& frameId);
+
+  // Thresholds for the translation [m] and rotation [rad] since the last sent
+  // transform, and the period [s] after which it is sent anyway. All poses are
+  // added if both thresholds are 0 (the default); if only one is, any change
+  // of that part is sent.
+  void setChangeThresholds(double translation, double rotation, double keepAlivePeriod);
+
+  // Adds the pose of the object in the given slot (e.g., its index). Returns
+  // false if it was skipped since it did not change.
+  bool add(
+    size_t slot,
+    const std::string& childFrameId,
+    const ros::Time& stamp,
+    const Eigen::Vector3f& position,
+    const Eigen::Quaternionf& rotation);
+
+  // Returns all transforms to their slots.
+  void clear();
+
+  const tf2_msgs::TFMessage& message() const
+  {
+    return m_message;
+  }
+
+  size_t size() const
+  {
+    return m_message.transforms.size();
+  }
+
+  bool empty() const
+  {
+    return m_message.transforms.empty();
+  }
+
+private:
+  const std::string m_frameId;
+  double m_minTranslationSquared;
+  // cosine of half the rotation threshold, as the quaternions hold half angles
+  double m_maxRotationCos;
+  ros::Duration m_keepAlivePeriod;
+  bool m_skipUnchanged;
+  std::vector<geometry_msgs::TransformStamped> m_slots;
+  std::vector<size_t> m_slotIndices;
+  tf2_msgs::TFMessage m_message;
+};
+
+} // namespace motion_capture_tracking
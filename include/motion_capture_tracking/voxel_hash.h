@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+namespace motion_capture_tracking {
+
+// Uniform grid over the points of a cloud, for fast box queries.
+//
+// Only occupied cells are stored, in an open-addressing hash table, and the
+// point indices are sorted by cell, so every cell is one contiguous range. The
+// index is meant to be rebuilt for every frame: all storage is reused, so
+// build() does not allocate once it has seen the largest cloud. Queries are
+// read-only and may run concurrently.
+class VoxelHash
+{
+public:
+  VoxelHash();
+
+  // Indexes cloud, which must stay alive and unchanged while crop() is used.
+  void build(const pcl::PointCloud<pcl::PointXYZ>& cloud, float cellSize);
+
+  // Replaces the content of result by all points within [min, max].
+  void crop(
+    const Eigen::Vector3f& min,
+    const Eigen::Vector3f& max,
+    pcl::PointCloud<pcl::PointXYZ>& result) const;
+
+  float cellSize() const
+  {
+    return m_cellSize;
+  }
+
+private:
+  struct Cell
+  {
+    uint64_t key;
+    // cell is in use if stamp == m_stamp
+    uint32_t stamp;
+    // range in m_order
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  uint64_t key(int64_t x, int64_t y, int64_t z) const;
+
+  int64_t coordinate(float value) const;
+
+  size_t insert(uint64_t key);
+
+  const Cell* find(uint64_t key) const;
+
+private:
+  const pcl::PointCloud<pcl::PointXYZ>* m_cloud;
+  float m_cellSize;
+  float m_inverseCellSize;
+
+  std::vector<Cell> m_cells;
+  size_t m_mask;
+  uint32_t m_stamp;
+  std::vector<uint32_t> m_occupied;
+  std::vector<uint32_t> m_pointCells;
+  std::vector<uint32_t> m_order;
+};
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,98 @@
+#include "motion_capture_tracking/allocation_counter.h"
+
+#ifdef MOTION_CAPTURE_TRACKING_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace motion_capture_tracking {
+
+#ifdef MOTION_CAPTURE_TRACKING_COUNT_ALLOCATIONS
+
+namespace {
+
+// constant-initialized, so it is ready for allocations of static constructors
+std::atomic<uint64_t> allocations(0);
+
+void* countedAllocate(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+} // anonymous namespace
+
+bool countingAllocations()
+{
+  return true;
+}
+
+uint64_t numAllocations()
+{
+  return allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool countingAllocations()
+{
+  return false;
+}
+
+uint64_t numAllocations()
+{
+  return 0;
+}
+
+#endif
+
+} // namespace motion_capture_tracking
+
+#ifdef MOTION_CAPTURE_TRACKING_COUNT_ALLOCATIONS
+
+void* operator new(size_t size)
+{
+  void* ptr = motion_capture_tracking::countedAllocate(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  return motion_capture_tracking::countedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  return motion_capture_tracking::countedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+#endif
@@ -0,0 +1,179 @@
+#include "motion_capture_tracking/async_cloud_logger.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include "motion_capture_tracking/cloud_log.h"
+
+namespace motion_capture_tracking {
+
+AsyncCloudLogger::AsyncCloudLogger(const Options& options)
+  : m_options(options)
+  , m_queue(options.queueSize, RingBuffer<Record>::OverflowPolicy::DropOldest)
+  , m_pending()
+  , m_fd(-1)
+  , m_fileIdx(0)
+  , m_fileSize(0)
+  , m_fileOpened()
+  , m_unsynced(false)
+  , m_chunk()
+  , m_numWritten(0)
+  , m_numBytesWritten(0)
+  , m_thread()
+{
+  const size_t reserveFloats = 3 * options.reservePoints;
+  m_queue.initialize([reserveFloats](Record& record) {
+    record.xyz.reserve(reserveFloats);
+  });
+  m_pending.xyz.reserve(reserveFloats);
+  m_chunk.reserve(options.chunkSize + cloud_log::recordSize(options.reservePoints));
+
+  if (openNextFile()) {
+    m_thread = std::thread(&AsyncCloudLogger::run, this);
+  }
+}
+
+AsyncCloudLogger::~AsyncCloudLogger()
+{
+  m_queue.close();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void AsyncCloudLogger::log(uint32_t millis, const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  m_pending.millis = millis;
+  m_pending.xyz.resize(3 * cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    m_pending.xyz[3 * i + 0] = cloud[i].x;
+    m_pending.xyz[3 * i + 1] = cloud[i].y;
+    m_pending.xyz[3 * i + 2] = cloud[i].z;
+  }
+  m_queue.push(m_pending);
+}
+
+void AsyncCloudLogger::run()
+{
+  typedef std::chrono::steady_clock Clock;
+  const std::chrono::duration<double> flushPeriod(m_options.flushPeriod);
+  const std::chrono::duration<double> syncPeriod(m_options.syncPeriod);
+
+  Record record;
+  Clock::time_point lastFlush = Clock::now();
+  Clock::time_point lastSync = lastFlush;
+  while (true) {
+    const bool popped = m_queue.pop(record, std::chrono::milliseconds(100));
+    if (popped) {
+      const uint32_t numPoints = record.xyz.size() / 3;
+      cloud_log::appendRecord(m_chunk, record.millis, record.xyz.data(), numPoints);
+      m_numWritten.fetch_add(1, std::memory_order_relaxed);
+    } else if (m_queue.closed()) {
+      break;
+    }
+
+    const Clock::time_point now = Clock::now();
+    if (m_chunk.size() >= m_options.chunkSize
+        || (!m_chunk.empty() && now - lastFlush >= flushPeriod)) {
+      writeChunk();
+      lastFlush = now;
+    }
+    if (m_unsynced && now - lastSync >= syncPeriod) {
+      sync();
+      lastSync = now;
+    }
+  }
+  writeChunk();
+  closeFile();
+}
+
+bool AsyncCloudLogger::openNextFile()
+{
+  std::string path = m_options.path;
+  if (m_options.maxFileSize > 0 || m_options.maxFileDuration > 0) {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), ".%04zu", m_fileIdx);
+    path += suffix;
+  }
+  ++m_fileIdx;
+
+  m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (m_fd < 0) {
+    ROS_ERROR("Could not open point cloud log %s: %s", path.c_str(), std::strerror(errno));
+    return false;
+  }
+  m_fileSize = 0;
+  m_fileOpened = std::chrono::steady_clock::now();
+  return true;
+}
+
+void AsyncCloudLogger::writeChunk()
+{
+  if (m_fd < 0) {
+    m_chunk.clear();
+    return;
+  }
+  if (m_chunk.empty()) {
+    return;
+  }
+
+  // rotate at chunk boundaries only, so that records are never split
+  const bool rotateBySize = m_options.maxFileSize > 0
+    && m_fileSize > 0
+    && m_fileSize + m_chunk.size() > m_options.maxFileSize;
+  const bool rotateByTime = m_options.maxFileDuration > 0
+    && std::chrono::steady_clock::now() - m_fileOpened
+       >= std::chrono::duration<double>(m_options.maxFileDuration);
+  if (rotateBySize || rotateByTime) {
+    closeFile();
+    if (!openNextFile()) {
+      m_chunk.clear();
+      return;
+    }
+  }
+
+  const char* data = m_chunk.data();
+  size_t remaining = m_chunk.size();
+  while (remaining > 0) {
+    const ssize_t written = ::write(m_fd, data, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ROS_ERROR("Could not write point cloud log: %s", std::strerror(errno));
+      closeFile();
+      break;
+    }
+    data += written;
+    remaining -= written;
+  }
+  m_fileSize += m_chunk.size() - remaining;
+  m_numBytesWritten.fetch_add(m_chunk.size() - remaining, std::memory_order_relaxed);
+  m_unsynced = true;
+  m_chunk.clear();
+}
+
+void AsyncCloudLogger::sync()
+{
+  if (m_fd >= 0) {
+    ::fdatasync(m_fd);
+  }
+  m_unsynced = false;
+}
+
+void AsyncCloudLogger::closeFile()
+{
+  if (m_fd >= 0) {
+    sync();
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+} // namespace motion_capture_tracking
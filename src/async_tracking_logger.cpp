@@ -0,0 +1,259 @@
+#include "motion_capture_tracking/async_tracking_logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+namespace motion_capture_tracking {
+
+namespace {
+
+template<typename T>
+T* columnAt(std::vector<char>& block, size_t offset)
+{
+  return reinterpret_cast<T*>(block.data() + offset);
+}
+
+} // anonymous namespace
+
+AsyncTrackingLogger::AsyncTrackingLogger(const Options& options)
+  : m_options(options)
+  , m_framesPerBlock(std::max<uint32_t>(options.framesPerBlock, 1))
+  , m_layout(tracking_log::layout(options.capacity, m_framesPerBlock))
+  , m_queue(options.queueSize, RingBuffer<Record>::OverflowPolicy::DropOldest)
+  , m_pending()
+  , m_names(options.capacity)
+  , m_namesMutex()
+  , m_sharedNames(options.capacity * tracking_log::NameSize, '\0')
+  , m_namesChanged(false)
+  , m_writtenNames(m_sharedNames)
+  , m_fd(-1)
+  , m_block(m_layout.blockSize, '\0')
+  , m_numFrames(0)
+  , m_numFramesWritten(0)
+  , m_blockIdx(0)
+  , m_unsynced(false)
+  , m_numWritten(0)
+  , m_numObjectsDropped(0)
+  , m_thread()
+{
+  const uint32_t capacity = options.capacity;
+  m_queue.initialize([capacity](Record& record) {
+    record.slots.resize(capacity);
+  });
+  m_pending.slots.resize(capacity);
+
+  m_fd = ::open(options.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (m_fd < 0) {
+    ROS_ERROR("Could not open tracking log %s: %s", options.path.c_str(), std::strerror(errno));
+    return;
+  }
+  std::vector<char> header(m_layout.headerSize, '\0');
+  tracking_log::FileHeader fileHeader;
+  std::memcpy(fileHeader.magic, tracking_log::Magic, sizeof(fileHeader.magic));
+  fileHeader.version = tracking_log::Version;
+  fileHeader.capacity = capacity;
+  fileHeader.framesPerBlock = m_framesPerBlock;
+  fileHeader.headerSize = m_layout.headerSize;
+  fileHeader.blockSize = m_layout.blockSize;
+  std::memcpy(header.data(), &fileHeader, sizeof(fileHeader));
+  if (!write(header.data(), header.size(), 0)) {
+    return;
+  }
+  m_thread = std::thread(&AsyncTrackingLogger::run, this);
+}
+
+AsyncTrackingLogger::~AsyncTrackingLogger()
+{
+  m_queue.close();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+void AsyncTrackingLogger::begin(uint64_t frameId, uint64_t timestamp, const ros::Time& stamp, uint32_t numMarkers)
+{
+  m_pending.frameId = frameId;
+  m_pending.timestamp = timestamp;
+  m_pending.stamp = stamp.toNSec();
+  m_pending.numMarkers = numMarkers;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for (auto& slot : m_pending.slots) {
+    std::fill(slot.position, slot.position + 3, nan);
+    std::fill(slot.orientation, slot.orientation + 4, nan);
+    slot.fitness = nan;
+    slot.iterations = 0;
+    slot.valid = 0;
+    slot.extrapolated = 0;
+  }
+}
+
+void AsyncTrackingLogger::add(
+  uint32_t id,
+  const std::string& name,
+  const Eigen::Vector3f& position,
+  const Eigen::Quaternionf& rotation,
+  bool valid,
+  bool extrapolated,
+  float fitness,
+  int iterations)
+{
+  if (id >= m_pending.slots.size()) {
+    m_numObjectsDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Slot& slot = m_pending.slots[id];
+  for (int i = 0; i < 3; ++i) {
+    slot.position[i] = position[i];
+  }
+  slot.orientation[0] = rotation.x();
+  slot.orientation[1] = rotation.y();
+  slot.orientation[2] = rotation.z();
+  slot.orientation[3] = rotation.w();
+  slot.fitness = fitness;
+  slot.iterations = static_cast<uint16_t>(std::min(std::max(iterations, 0), 0xffff));
+  slot.valid = valid;
+  slot.extrapolated = extrapolated;
+
+  // names only change when objects are added at runtime
+  if (m_names[id] != name) {
+    m_names[id] = name;
+    std::lock_guard<std::mutex> lock(m_namesMutex);
+    char* slotName = m_sharedNames.data() + id * tracking_log::NameSize;
+    std::memset(slotName, 0, tracking_log::NameSize);
+    std::memcpy(slotName, name.data(), std::min(name.size(), tracking_log::NameSize - 1));
+    m_namesChanged = true;
+  }
+}
+
+void AsyncTrackingLogger::commit()
+{
+  m_queue.push(m_pending);
+}
+
+void AsyncTrackingLogger::run()
+{
+  typedef std::chrono::steady_clock Clock;
+  const std::chrono::duration<double> flushPeriod(m_options.flushPeriod);
+  const std::chrono::duration<double> syncPeriod(m_options.syncPeriod);
+
+  Record record;
+  Clock::time_point lastFlush = Clock::now();
+  Clock::time_point lastSync = lastFlush;
+  while (true) {
+    const bool popped = m_queue.pop(record, std::chrono::milliseconds(100));
+    if (popped) {
+      append(record);
+      m_numWritten.fetch_add(1, std::memory_order_relaxed);
+    } else if (m_queue.closed()) {
+      break;
+    }
+
+    const Clock::time_point now = Clock::now();
+    if (m_numFrames == m_framesPerBlock
+        || (m_numFrames > m_numFramesWritten && now - lastFlush >= flushPeriod)) {
+      writeBlock();
+      lastFlush = now;
+    }
+    if (m_unsynced && now - lastSync >= syncPeriod) {
+      if (m_fd >= 0) {
+        ::fdatasync(m_fd);
+      }
+      m_unsynced = false;
+      lastSync = now;
+    }
+  }
+  if (m_numFrames > m_numFramesWritten) {
+    writeBlock();
+  }
+  if (m_fd >= 0) {
+    ::fdatasync(m_fd);
+  }
+}
+
+void AsyncTrackingLogger::append(const Record& record)
+{
+  const size_t frame = m_numFrames;
+  columnAt<uint64_t>(m_block, m_layout.frameId)[frame] = record.frameId;
+  columnAt<uint64_t>(m_block, m_layout.timestamp)[frame] = record.timestamp;
+  columnAt<int64_t>(m_block, m_layout.stamp)[frame] = record.stamp;
+  columnAt<uint32_t>(m_block, m_layout.numMarkers)[frame] = record.numMarkers;
+
+  const size_t first = frame * m_options.capacity;
+  float* position = columnAt<float>(m_block, m_layout.position) + 3 * first;
+  float* orientation = columnAt<float>(m_block, m_layout.orientation) + 4 * first;
+  float* fitness = columnAt<float>(m_block, m_layout.fitness) + first;
+  uint16_t* iterations = columnAt<uint16_t>(m_block, m_layout.iterations) + first;
+  uint8_t* valid = columnAt<uint8_t>(m_block, m_layout.valid) + first;
+  uint8_t* extrapolated = columnAt<uint8_t>(m_block, m_layout.extrapolated) + first;
+  for (size_t i = 0; i < record.slots.size(); ++i) {
+    const Slot& slot = record.slots[i];
+    std::memcpy(position + 3 * i, slot.position, sizeof(slot.position));
+    std::memcpy(orientation + 4 * i, slot.orientation, sizeof(slot.orientation));
+    fitness[i] = slot.fitness;
+    iterations[i] = slot.iterations;
+    valid[i] = slot.valid;
+    extrapolated[i] = slot.extrapolated;
+  }
+  ++m_numFrames;
+}
+
+void AsyncTrackingLogger::writeBlock()
+{
+  if (m_namesChanged.exchange(false)) {
+    {
+      std::lock_guard<std::mutex> lock(m_namesMutex);
+      std::copy(m_sharedNames.begin(), m_sharedNames.end(), m_writtenNames.begin());
+    }
+    write(m_writtenNames.data(), m_writtenNames.size(), sizeof(tracking_log::FileHeader));
+  }
+
+  tracking_log::BlockHeader header;
+  header.numFrames = m_numFrames;
+  header.reserved = 0;
+  std::memcpy(m_block.data(), &header, sizeof(header));
+  write(m_block.data(), m_block.size(), m_layout.headerSize + m_blockIdx * m_layout.blockSize);
+  m_numFramesWritten = m_numFrames;
+
+  if (m_numFrames == m_framesPerBlock) {
+    ++m_blockIdx;
+    m_numFrames = 0;
+    m_numFramesWritten = 0;
+    std::fill(m_block.begin(), m_block.end(), '\0');
+  }
+}
+
+bool AsyncTrackingLogger::write(const char* data, size_t size, uint64_t offset)
+{
+  if (m_fd < 0) {
+    return false;
+  }
+  while (size > 0) {
+    const ssize_t written = ::pwrite(m_fd, data, size, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ROS_ERROR("Could not write tracking log: %s", std::strerror(errno));
+      ::close(m_fd);
+      m_fd = -1;
+      return false;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  m_unsynced = true;
+  return true;
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,98 @@
+#include "motion_capture_tracking/clock_mapper.h"
+
+#include <cmath>
+
+namespace motion_capture_tracking {
+
+namespace {
+
+// share of a late arrival that is applied to the offset (per frame)
+const double OffsetGain = 0.002;
+
+// share of the rate error that is applied per window
+const double RateGain = 0.5;
+
+} // anonymous namespace
+
+ClockMapper::ClockMapper(
+  double windowDuration,
+  double resetThreshold)
+  : m_windowDuration(windowDuration)
+  , m_resetThreshold(resetThreshold)
+  , m_initialized(false)
+  , m_refMocap(0)
+  , m_refRos(0)
+  , m_rate(1.0)
+  , m_windowStart(0)
+  , m_windowCorrection(0)
+  , m_numWindows(0)
+  , m_lastMocapTime(0)
+  , m_lastDelay(0)
+  , m_numResets(0)
+{
+}
+
+void ClockMapper::update(uint64_t mocapTime, const ros::Time& arrivalTime)
+{
+  const double arrival = arrivalTime.toSec();
+
+  if (m_initialized
+      && (mocapTime < m_lastMocapTime
+          || std::fabs(arrival - predict(mocapTime)) > m_resetThreshold)) {
+    m_initialized = false;
+    ++m_numResets;
+  }
+
+  if (!m_initialized) {
+    m_refMocap = mocapTime;
+    m_refRos = arrival;
+    m_rate = 1.0;
+    m_windowStart = mocapTime;
+    m_windowCorrection = 0;
+    m_numWindows = 0;
+    m_lastMocapTime = mocapTime;
+    m_lastDelay = 0;
+    m_initialized = true;
+    return;
+  }
+
+  const double residual = arrival - predict(mocapTime);
+  const double correction = residual < 0 ? residual : OffsetGain * residual;
+  m_refRos += correction;
+  m_windowCorrection += correction;
+  m_lastDelay = residual - correction;
+  m_lastMocapTime = mocapTime;
+
+  const double windowElapsed = (mocapTime - m_windowStart) * 1e-6;
+  if (windowElapsed >= m_windowDuration) {
+    // rebase on the current frame, so that the mapping stays continuous
+    m_refRos = predict(mocapTime);
+    m_refMocap = mocapTime;
+    // the first window mostly converges on the initial offset
+    if (m_numWindows > 0) {
+      m_rate += RateGain * m_windowCorrection / windowElapsed;
+    }
+    ++m_numWindows;
+    m_windowStart = mocapTime;
+    m_windowCorrection = 0;
+  }
+}
+
+ros::Time ClockMapper::map(uint64_t mocapTime) const
+{
+  return ros::Time(predict(mocapTime));
+}
+
+double ClockMapper::offset() const
+{
+  return predict(m_lastMocapTime) - m_lastMocapTime * 1e-6;
+}
+
+double ClockMapper::predict(uint64_t mocapTime) const
+{
+  // signed, since frames may be mapped that are older than the reference
+  const double dt = (static_cast<int64_t>(mocapTime) - static_cast<int64_t>(m_refMocap)) * 1e-6;
+  return m_refRos + m_rate * dt;
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,91 @@
+#include "motion_capture_tracking/frame_acquisition.h"
+
+#include <thread>
+
+#include <ros/ros.h>
+
+#include "motion_capture_tracking/tracer.h"
+
+namespace motion_capture_tracking {
+
+FrameAcquisition::State::State(
+  std::unique_ptr<FrameSource> source,
+  size_t queueSize,
+  FrameQueue::OverflowPolicy policy)
+  : source(std::move(source))
+  , queue(queueSize, policy)
+  , withPointCloud(true)
+  , mutex()
+  , finishedCondition()
+  , threadFinished(false)
+{
+}
+
+FrameAcquisition::FrameAcquisition(
+  std::unique_ptr<FrameSource> source,
+  size_t queueSize,
+  FrameQueue::OverflowPolicy policy)
+  : m_state(std::make_shared<State>(std::move(source), queueSize, policy))
+  , m_started(false)
+{
+}
+
+FrameAcquisition::~FrameAcquisition()
+{
+  stop(std::chrono::seconds(1));
+}
+
+void FrameAcquisition::start()
+{
+  // never joined; stop() waits for threadFinished instead, so that it can
+  // give up on a blocked source
+  std::thread(&FrameAcquisition::run, m_state).detach();
+  m_started = true;
+}
+
+bool FrameAcquisition::stop(std::chrono::milliseconds timeout)
+{
+  m_state->queue.close();
+  if (!m_started) {
+    return true;
+  }
+  m_state->source->interrupt();
+  std::unique_lock<std::mutex> lock(m_state->mutex);
+  const bool finished = m_state->finishedCondition.wait_for(lock, timeout,
+    [this] { return m_state->threadFinished; });
+  if (!finished) {
+    ROS_WARN("Motion capture source did not return within %.1f s; abandoning it.",
+      std::chrono::duration<double>(timeout).count());
+  }
+  m_started = false;
+  return finished;
+}
+
+void FrameAcquisition::run(std::shared_ptr<State> state)
+{
+  setTraceThreadName("acquisition");
+  Frame frame;
+  for (uint64_t frameId = 0; !state->queue.closed() && ros::ok(); ++frameId) {
+    const bool withPointCloud = state->withPointCloud.load(std::memory_order_relaxed);
+    {
+      TraceScope trace("wait for frame", "frame", frameId);
+      if (!state->source->waitForNextFrame(frame, withPointCloud)) {
+        break;
+      }
+    }
+    frame.frameId = frameId;
+    frame.acquisitionTime = (ros::Time::now() - frame.arrivalTime).toNSec() / 1000;
+    if (!state->queue.push(frame)) {
+      break;
+    }
+  }
+  // lets the consumer finish once the last frame has been processed
+  state->queue.close();
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->threadFinished = true;
+  }
+  state->finishedCondition.notify_all();
+}
+
+} // namespace motion_capture_tracking
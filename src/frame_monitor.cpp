@@ -0,0 +1,73 @@
+#include "motion_capture_tracking/frame_monitor.h"
+
+#include <algorithm>
+
+namespace motion_capture_tracking {
+
+const size_t FrameMonitor::WindowSize;
+
+FrameMonitor::FrameMonitor(double timeoutFactor)
+  : m_timeoutFactor(timeoutFactor)
+  , m_intervals()
+  , m_numIntervals(0)
+  , m_nextInterval(0)
+  , m_nominalInterval(0)
+  , m_hasFrame(false)
+  , m_lastArrival()
+  , m_lost(false)
+  , m_lastGap(0)
+  , m_numGaps(0)
+  , m_numLosses(0)
+{
+}
+
+bool FrameMonitor::frame(uint64_t interval, Clock::time_point arrivalTime)
+{
+  if (interval == 0 && m_hasFrame) {
+    interval = std::chrono::duration_cast<std::chrono::microseconds>(arrivalTime - m_lastArrival).count();
+  }
+  m_hasFrame = true;
+  m_lastArrival = arrivalTime;
+  m_lost = false;
+  if (interval == 0) {
+    return false;
+  }
+
+  const bool gap = m_nominalInterval != 0 && interval > m_timeoutFactor * m_nominalInterval;
+  if (gap) {
+    m_lastGap = interval;
+    ++m_numGaps;
+  }
+
+  // gaps are part of the window, so that a lower frame rate is adopted
+  m_intervals[m_nextInterval] = interval;
+  m_nextInterval = (m_nextInterval + 1) % WindowSize;
+  m_numIntervals = std::min(m_numIntervals + 1, WindowSize);
+  std::array<uint64_t, WindowSize> sorted = m_intervals;
+  const auto quartile = sorted.begin() + m_numIntervals * 3 / 4;
+  std::nth_element(sorted.begin(), quartile, sorted.begin() + m_numIntervals);
+  m_nominalInterval = *quartile;
+  return gap;
+}
+
+bool FrameMonitor::checkStall(Clock::time_point now)
+{
+  if (m_lost || m_nominalInterval == 0 || timeUntilStall(now) > Clock::duration::zero()) {
+    return false;
+  }
+  m_lost = true;
+  m_lastGap = std::chrono::duration_cast<std::chrono::microseconds>(now - m_lastArrival).count();
+  ++m_numLosses;
+  return true;
+}
+
+FrameMonitor::Clock::duration FrameMonitor::timeUntilStall(Clock::time_point now) const
+{
+  if (m_nominalInterval == 0) {
+    return Clock::duration(-1);
+  }
+  const std::chrono::microseconds timeout(static_cast<int64_t>(m_timeoutFactor * m_nominalInterval));
+  return m_lastArrival + timeout - now;
+}
+
+} // namespace motion_capture_tracking
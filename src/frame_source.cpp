@@ -0,0 +1,47 @@
+#include "motion_capture_tracking/frame_source.h"
+
+namespace motion_capture_tracking {
+
+MocapFrameSource::MocapFrameSource(
+  libmotioncapture::MotionCapture* mocap,
+  bool withRigidBodies)
+  : m_mocap(mocap)
+  , m_withRigidBodies(withRigidBodies)
+{
+}
+
+MocapFrameSource::~MocapFrameSource()
+{
+  delete m_mocap;
+}
+
+bool MocapFrameSource::waitForNextFrame(Frame& frame, bool withPointCloud)
+{
+  m_mocap->waitForNextFrame();
+  frame.arrivalTime = ros::Time::now();
+  frame.timestamp = m_mocap->timeStamp();
+  if (withPointCloud) {
+    // The SDK hands out a new cloud every frame. Its content is copied into
+    // the frame's own cloud, which is recycled through the frame queue, so
+    // that the SDK's memory is allocated and freed on this thread only.
+    const pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = m_mocap->pointCloud();
+    if (!frame.markers || !frame.markers.unique()) {
+      frame.markers.reset(new pcl::PointCloud<pcl::PointXYZ>);
+    }
+    frame.markers->points.assign(cloud->points.begin(), cloud->points.end());
+    frame.markers->width = cloud->points.size();
+    frame.markers->height = 1;
+  }
+  frame.hasMarkers = withPointCloud;
+  if (m_withRigidBodies) {
+    m_mocap->getObjects(frame.rigidBodies);
+  }
+  return true;
+}
+
+bool MocapFrameSource::supportsObjectTracking() const
+{
+  return m_mocap->supportsObjectTracking();
+}
+
+} // namespace motion_capture_tracking
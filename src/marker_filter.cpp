@@ -0,0 +1,263 @@
+#include "motion_capture_tracking/marker_filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <ros/ros.h>
+
+namespace motion_capture_tracking {
+
+namespace {
+
+// cell coordinates are stored with 21 bits per axis
+const int64_t CoordinateBits = 21;
+const int64_t CoordinateOffset = int64_t(1) << (CoordinateBits - 1);
+const int64_t CoordinateMax = (int64_t(1) << CoordinateBits) - 1;
+
+int64_t clampCoordinate(int64_t coordinate)
+{
+  return std::max<int64_t>(0, std::min(coordinate, CoordinateMax));
+}
+
+// Cell coordinates of point; false if it is not finite
+bool cellOf(const pcl::PointXYZ& point, float inverseCellSize, int64_t* coordinates)
+{
+  const float values[3] = {point.x, point.y, point.z};
+  for (int axis = 0; axis < 3; ++axis) {
+    if (!std::isfinite(values[axis])) {
+      return false;
+    }
+    const int64_t coordinate = static_cast<int64_t>(std::floor(values[axis] * inverseCellSize)) + CoordinateOffset;
+    coordinates[axis] = clampCoordinate(coordinate);
+  }
+  return true;
+}
+
+// Neighbors of the cells on the border of the grid are clamped to it, rather
+// than wrapping around into the other fields of the key
+uint64_t cellKey(int64_t x, int64_t y, int64_t z)
+{
+  return (uint64_t(clampCoordinate(x)) << (2 * CoordinateBits))
+    | (uint64_t(clampCoordinate(y)) << CoordinateBits)
+    | uint64_t(clampCoordinate(z));
+}
+
+} // anonymous namespace
+
+MarkerFilter::MarkerFilter(const Options& options)
+  : m_options(options)
+  , m_useBox((options.boxMin.array() < options.boxMax.array()).all())
+  , m_numFrames(0)
+  , m_occupancy()
+  , m_staticCells()
+  , m_keep()
+  , m_inside()
+  , m_cells()
+  , m_numOutside(0)
+  , m_numStatic(0)
+  , m_numDuplicates(0)
+{
+}
+
+bool MarkerFilter::enabled() const
+{
+  return m_useBox
+    || m_options.polygon.size() >= 3
+    || m_options.staticFrames > 0
+    || m_options.minDistance > 0;
+}
+
+void MarkerFilter::filter(pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  if (m_useBox || m_options.polygon.size() >= 3) {
+    cropVolume(cloud);
+    m_numOutside.fetch_add(compact(cloud), std::memory_order_relaxed);
+  }
+
+  if (learning()) {
+    learnStatic(cloud);
+  } else if (!m_staticCells.empty()) {
+    maskStatic(cloud);
+    m_numStatic.fetch_add(compact(cloud), std::memory_order_relaxed);
+  }
+
+  if (m_options.minDistance > 0) {
+    maskDuplicates(cloud);
+    m_numDuplicates.fetch_add(compact(cloud), std::memory_order_relaxed);
+  }
+}
+
+size_t MarkerFilter::compact(pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  auto& points = cloud.points;
+  size_t numKept = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    points[numKept] = points[i];
+    numKept += m_keep[i];
+  }
+  const size_t numRemoved = points.size() - numKept;
+  points.resize(numKept);
+  cloud.width = numKept;
+  cloud.height = 1;
+  return numRemoved;
+}
+
+void MarkerFilter::cropVolume(const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  const size_t size = cloud.points.size();
+  m_keep.assign(size, 1);
+  // locals, as the masks could alias anything else to the compiler
+  const pcl::PointXYZ* points = cloud.points.data();
+  uint8_t* keep = m_keep.data();
+
+  if (m_useBox) {
+    const float minX = m_options.boxMin.x();
+    const float minY = m_options.boxMin.y();
+    const float minZ = m_options.boxMin.z();
+    const float maxX = m_options.boxMax.x();
+    const float maxY = m_options.boxMax.y();
+    const float maxZ = m_options.boxMax.z();
+    for (size_t i = 0; i < size; ++i) {
+      const float x = points[i].x;
+      const float y = points[i].y;
+      const float z = points[i].z;
+      keep[i] = (x >= minX) & (x <= maxX) & (y >= minY) & (y <= maxY) & (z >= minZ) & (z <= maxZ);
+    }
+  }
+
+  // even-odd rule: a point is inside if a ray towards +x crosses an odd
+  // number of edges
+  const auto& polygon = m_options.polygon;
+  if (polygon.size() >= 3) {
+    m_inside.assign(size, 0);
+    uint8_t* inside = m_inside.data();
+    for (size_t e = 0; e < polygon.size(); ++e) {
+      const float ax = polygon[e].x();
+      const float ay = polygon[e].y();
+      const float by = polygon[(e + 1) % polygon.size()].y();
+      if (ay == by) {
+        continue;
+      }
+      const float inverseSlope = (polygon[(e + 1) % polygon.size()].x() - ax) / (by - ay);
+      for (size_t i = 0; i < size; ++i) {
+        const float x = points[i].x;
+        const float y = points[i].y;
+        const bool crosses = (ay > y) != (by > y);
+        inside[i] ^= crosses & (x < ax + (y - ay) * inverseSlope);
+      }
+    }
+    for (size_t i = 0; i < size; ++i) {
+      keep[i] &= inside[i];
+    }
+  }
+}
+
+void MarkerFilter::learnStatic(const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  const float inverseCellSize = 1.0f / m_options.staticCellSize;
+  ++m_numFrames;
+  for (const auto& point : cloud.points) {
+    int64_t c[3];
+    if (!cellOf(point, inverseCellSize, c)) {
+      continue;
+    }
+    const Eigen::Vector3f position(point.x, point.y, point.z);
+    bool isProtected = false;
+    for (size_t i = 0; i < m_options.protectedPositions.size(); ++i) {
+      const float radius = m_options.protectedRadii[i];
+      if ((position - m_options.protectedPositions[i]).squaredNorm() < radius * radius) {
+        isProtected = true;
+        break;
+      }
+    }
+    if (isProtected) {
+      continue;
+    }
+    // counted once per frame
+    auto& occupancy = m_occupancy[cellKey(c[0], c[1], c[2])];
+    if (occupancy.second != m_numFrames) {
+      ++occupancy.first;
+      occupancy.second = m_numFrames;
+    }
+  }
+
+  if (learning()) {
+    return;
+  }
+  // the neighbors are included, so that a static marker near a cell boundary
+  // is caught on both sides
+  size_t numPlaces = 0;
+  for (const auto& cell : m_occupancy) {
+    if (cell.second.first < m_options.staticFraction * m_numFrames) {
+      continue;
+    }
+    ++numPlaces;
+    const int64_t x = cell.first >> (2 * CoordinateBits);
+    const int64_t y = (cell.first >> CoordinateBits) & CoordinateMax;
+    const int64_t z = cell.first & CoordinateMax;
+    for (int64_t dx = -1; dx <= 1; ++dx) {
+      for (int64_t dy = -1; dy <= 1; ++dy) {
+        for (int64_t dz = -1; dz <= 1; ++dz) {
+          m_staticCells.insert(cellKey(x + dx, y + dy, z + dz));
+        }
+      }
+    }
+  }
+  std::unordered_map<uint64_t, std::pair<size_t, size_t> >().swap(m_occupancy);
+  ROS_INFO("Learned %zu static marker places from %zu frames.", numPlaces, m_numFrames);
+}
+
+void MarkerFilter::maskStatic(const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  const float inverseCellSize = 1.0f / m_options.staticCellSize;
+  const auto& points = cloud.points;
+  m_keep.resize(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    int64_t c[3];
+    m_keep[i] = !cellOf(points[i], inverseCellSize, c)
+      || m_staticCells.find(cellKey(c[0], c[1], c[2])) == m_staticCells.end();
+  }
+}
+
+void MarkerFilter::maskDuplicates(const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  const float distance = m_options.minDistance;
+  const float inverseCellSize = 1.0f / distance;
+  const auto& points = cloud.points;
+  m_keep.assign(points.size(), 1);
+  m_cells.clear();
+  for (size_t i = 0; i < points.size(); ++i) {
+    int64_t c[3];
+    if (cellOf(points[i], inverseCellSize, c)) {
+      m_cells.push_back(std::make_pair(cellKey(c[0], c[1], c[2]), static_cast<uint32_t>(i)));
+    }
+  }
+  std::sort(m_cells.begin(), m_cells.end());
+
+  // greedy in the order of the cloud: a point is dropped if it is too close to
+  // an earlier point that was kept
+  for (size_t i = 0; i < points.size(); ++i) {
+    int64_t c[3];
+    if (!cellOf(points[i], inverseCellSize, c)) {
+      continue;
+    }
+    const Eigen::Vector3f position = points[i].getVector3fMap();
+    for (int64_t dx = -1; dx <= 1 && m_keep[i]; ++dx) {
+      for (int64_t dy = -1; dy <= 1 && m_keep[i]; ++dy) {
+        for (int64_t dz = -1; dz <= 1 && m_keep[i]; ++dz) {
+          const uint64_t key = cellKey(c[0] + dx, c[1] + dy, c[2] + dz);
+          auto it = std::lower_bound(m_cells.begin(), m_cells.end(), std::make_pair(key, uint32_t(0)));
+          for (; it != m_cells.end() && it->first == key && it->second < i; ++it) {
+            if (m_keep[it->second]
+                && (points[it->second].getVector3fMap() - position).squaredNorm() < distance * distance) {
+              m_keep[i] = 0;
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace motion_capture_tracking
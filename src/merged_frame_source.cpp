@@ -0,0 +1,195 @@
+#include "motion_capture_tracking/merged_frame_source.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace motion_capture_tracking {
+
+MergedFrameSource::MergedFrameSource(
+  std::vector<std::unique_ptr<FrameSource> > sources,
+  const Options& options)
+  : m_options(options)
+  , m_inputs()
+  , m_interrupted(false)
+  , m_voxelHash()
+  , m_neighbors()
+  , m_accepted()
+  , m_numMerged(0)
+  , m_numSkipped(0)
+  , m_numDuplicates(0)
+{
+  m_inputs.reserve(sources.size());
+  for (auto& source : sources) {
+    m_inputs.emplace_back();
+    Input& input = m_inputs.back();
+    input.acquisition.reset(new FrameAcquisition(std::move(source), options.queueSize,
+      FrameAcquisition::FrameQueue::OverflowPolicy::DropOldest));
+    input.hasFrame = false;
+    input.consumed = false;
+    input.hasNext = false;
+    input.stalled = false;
+  }
+  for (auto& input : m_inputs) {
+    input.acquisition->start();
+  }
+}
+
+MergedFrameSource::~MergedFrameSource()
+{
+  for (auto& input : m_inputs) {
+    input.acquisition->stop(std::chrono::seconds(1));
+  }
+}
+
+bool MergedFrameSource::waitForNextFrame(Frame& frame, bool withPointCloud)
+{
+  for (auto& input : m_inputs) {
+    input.acquisition->setWithPointCloud(withPointCloud);
+  }
+
+  // every primary frame yields a merged frame
+  Input& primary = m_inputs[0];
+  while (!primary.acquisition->pop(primary.frame, std::chrono::milliseconds(100))) {
+    if (m_interrupted.load() || primary.acquisition->finished()) {
+      return false;
+    }
+  }
+  primary.time = primary.frame.arrivalTime;
+  if (primary.frame.timestamp != 0) {
+    primary.clockMapper.update(primary.frame.timestamp, primary.frame.arrivalTime);
+    primary.time = primary.clockMapper.map(primary.frame.timestamp);
+  }
+
+  frame.timestamp = primary.frame.timestamp;
+  frame.arrivalTime = primary.frame.arrivalTime;
+  frame.hasMarkers = withPointCloud && primary.frame.hasMarkers;
+  frame.rigidBodies.clear();
+  if (frame.hasMarkers) {
+    if (!frame.markers || !frame.markers.unique()) {
+      frame.markers.reset(new pcl::PointCloud<pcl::PointXYZ>);
+    }
+    frame.markers->points.assign(primary.frame.markers->points.begin(), primary.frame.markers->points.end());
+  }
+
+  const std::chrono::microseconds maxSkew(static_cast<int64_t>(m_options.maxSkew * 1e6));
+  for (size_t i = 1; i < m_inputs.size(); ++i) {
+    Input& input = m_inputs[i];
+    advance(input, primary.time);
+    // the frame matching the primary one may still be on its way
+    const bool candidate = input.hasFrame && !input.consumed
+      && (primary.time - input.time).toSec() <= m_options.maxSkew;
+    if (!input.hasNext && !candidate && !input.stalled) {
+      if (pop(input, maxSkew)) {
+        advance(input, primary.time);
+      } else {
+        input.stalled = true;
+      }
+    }
+    const Frame* secondary = match(input, primary.time);
+    if (secondary && secondary->hasMarkers) {
+      if (frame.hasMarkers) {
+        merge(*secondary->markers, *frame.markers);
+      }
+      m_numMerged.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      m_numSkipped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (frame.hasMarkers) {
+    frame.markers->width = frame.markers->points.size();
+    frame.markers->height = 1;
+  }
+  return true;
+}
+
+void MergedFrameSource::interrupt()
+{
+  // noticed within 100 ms; the sources are stopped on destruction
+  m_interrupted = true;
+}
+
+bool MergedFrameSource::pop(Input& input, std::chrono::microseconds timeout)
+{
+  if (input.hasNext) {
+    return true;
+  }
+  if (!input.acquisition->pop(input.next, timeout)) {
+    return false;
+  }
+  input.hasNext = true;
+  input.stalled = false;
+  input.nextTime = input.next.arrivalTime;
+  if (input.next.timestamp != 0) {
+    input.clockMapper.update(input.next.timestamp, input.next.arrivalTime);
+    input.nextTime = input.clockMapper.map(input.next.timestamp);
+  }
+  return true;
+}
+
+void MergedFrameSource::advance(Input& input, const ros::Time& time)
+{
+  // frames arrive in order, so every frame up to time is nearer than the ones
+  // before it
+  while (pop(input, std::chrono::microseconds(0)) && input.nextTime <= time) {
+    std::swap(input.frame, input.next);
+    input.hasFrame = true;
+    input.consumed = false;
+    input.time = input.nextTime;
+    input.hasNext = false;
+  }
+}
+
+const Frame* MergedFrameSource::match(Input& input, const ros::Time& time)
+{
+  const double infinity = std::numeric_limits<double>::infinity();
+  const double skew = input.hasFrame && !input.consumed ? (time - input.time).toSec() : infinity;
+  const double nextSkew = input.hasNext ? (input.nextTime - time).toSec() : infinity;
+  if (std::min(skew, nextSkew) > m_options.maxSkew) {
+    return nullptr;
+  }
+  if (nextSkew < skew) {
+    std::swap(input.frame, input.next);
+    input.hasFrame = true;
+    input.time = input.nextTime;
+    input.hasNext = false;
+  }
+  input.consumed = true;
+  return &input.frame;
+}
+
+void MergedFrameSource::merge(
+  const pcl::PointCloud<pcl::PointXYZ>& cloud,
+  pcl::PointCloud<pcl::PointXYZ>& merged)
+{
+  const float distance = m_options.duplicateDistance;
+  if (distance <= 0 || merged.empty()) {
+    merged.points.insert(merged.points.end(), cloud.points.begin(), cloud.points.end());
+    return;
+  }
+
+  // the index refers to merged, which therefore must not change until all
+  // points have been checked
+  m_voxelHash.build(merged, 2 * distance);
+  const Eigen::Vector3f extent(distance, distance, distance);
+  for (const auto& point : cloud.points) {
+    const Eigen::Vector3f position(point.x, point.y, point.z);
+    m_voxelHash.crop(position - extent, position + extent, m_neighbors);
+    bool duplicate = false;
+    for (const auto& neighbor : m_neighbors.points) {
+      if ((Eigen::Vector3f(neighbor.x, neighbor.y, neighbor.z) - position).squaredNorm() <= distance * distance) {
+        duplicate = true;
+        break;
+      }
+    }
+    if (duplicate) {
+      m_numDuplicates.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      m_accepted.points.push_back(point);
+    }
+  }
+  merged.points.insert(merged.points.end(), m_accepted.points.begin(), m_accepted.points.end());
+  m_accepted.points.clear();
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,200 @@
+#include "motion_capture_tracking/metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+namespace motion_capture_tracking {
+
+namespace {
+
+std::string toString(double value)
+{
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+  return buffer;
+}
+
+void addValue(
+  diagnostic_msgs::DiagnosticStatus& status,
+  const std::string& key,
+  const std::string& value)
+{
+  diagnostic_msgs::KeyValue keyValue;
+  keyValue.key = key;
+  keyValue.value = value;
+  status.values.push_back(keyValue);
+}
+
+} // anonymous namespace
+
+Histogram::Histogram(const std::string& name, const std::string& unit)
+  : m_name(name)
+  , m_unit(unit)
+  , m_count(0)
+  , m_sum(0)
+  , m_max(0)
+{
+  for (auto& bucket : m_buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::record(uint64_t value)
+{
+  m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = m_max.load(std::memory_order_relaxed);
+  while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Summary Histogram::collect()
+{
+  uint64_t counts[NumBuckets];
+  uint64_t count = 0;
+  for (size_t i = 0; i < NumBuckets; ++i) {
+    counts[i] = m_buckets[i].exchange(0, std::memory_order_relaxed);
+    count += counts[i];
+  }
+  m_count.exchange(0, std::memory_order_relaxed);
+  const uint64_t sum = m_sum.exchange(0, std::memory_order_relaxed);
+  const uint64_t max = m_max.exchange(0, std::memory_order_relaxed);
+
+  Summary summary = {count, 0, 0, 0, 0, max};
+  if (count == 0) {
+    return summary;
+  }
+  summary.mean = static_cast<double>(sum) / count;
+
+  const uint64_t ranks[] = {(count * 50 + 99) / 100, (count * 90 + 99) / 100, (count * 99 + 99) / 100};
+  uint64_t* percentiles[] = {&summary.p50, &summary.p90, &summary.p99};
+  uint64_t seen = 0;
+  size_t rank = 0;
+  for (size_t i = 0; i < NumBuckets && rank < 3; ++i) {
+    seen += counts[i];
+    while (rank < 3 && seen >= ranks[rank]) {
+      *percentiles[rank] = std::min(bucketUpperBound(i), max);
+      ++rank;
+    }
+  }
+  return summary;
+}
+
+size_t Histogram::bucketIndex(uint64_t value)
+{
+  const uint64_t subBuckets = 1 << SubBucketBits;
+  if (value < subBuckets) {
+    return value;
+  }
+  const size_t msb = 63 - __builtin_clzll(value);
+  const size_t shift = msb - SubBucketBits;
+  const size_t subBucket = (value >> shift) & (subBuckets - 1);
+  return ((shift + 1) << SubBucketBits) + subBucket;
+}
+
+uint64_t Histogram::bucketUpperBound(size_t idx)
+{
+  const uint64_t subBuckets = 1 << SubBucketBits;
+  if (idx < subBuckets) {
+    return idx;
+  }
+  const size_t shift = (idx >> SubBucketBits) - 1;
+  const uint64_t lower = (subBuckets + (idx & (subBuckets - 1))) << shift;
+  return lower + (uint64_t(1) << shift) - 1;
+}
+
+Counter& Metrics::counter(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_counters.emplace_back(name);
+  return m_counters.back();
+}
+
+Gauge& Metrics::gauge(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_gauges.emplace_back(name);
+  return m_gauges.back();
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& unit)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_histograms.emplace_back(name, unit);
+  return m_histograms.back();
+}
+
+void Metrics::addCallback(const std::string& name, std::function<double()> value)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_callbacks.emplace_back(name, value);
+}
+
+void Metrics::report(diagnostic_msgs::DiagnosticStatus& status)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto& counter : m_counters) {
+    addValue(status, counter.name(), std::to_string(counter.value()));
+  }
+  for (const auto& gauge : m_gauges) {
+    addValue(status, gauge.name(), toString(gauge.value()));
+  }
+  for (const auto& callback : m_callbacks) {
+    addValue(status, callback.first, toString(callback.second()));
+  }
+  for (auto& histogram : m_histograms) {
+    const Histogram::Summary summary = histogram.collect();
+    addValue(status, histogram.name() + " [" + histogram.unit() + "]",
+      "n " + std::to_string(summary.count)
+      + ", mean " + toString(summary.mean)
+      + ", p50 " + std::to_string(summary.p50)
+      + ", p90 " + std::to_string(summary.p90)
+      + ", p99 " + std::to_string(summary.p99)
+      + ", max " + std::to_string(summary.max));
+  }
+}
+
+MetricsReporter::MetricsReporter(
+  Metrics& metrics,
+  ros::NodeHandle& nh,
+  const std::string& name,
+  double period)
+  : m_metrics(metrics)
+  , m_publisher(nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1))
+  , m_name(name)
+  , m_period(period)
+  , m_stop(false)
+  , m_thread(&MetricsReporter::run, this)
+{
+}
+
+MetricsReporter::~MetricsReporter()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_stopCondition.notify_all();
+  m_thread.join();
+}
+
+void MetricsReporter::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_stopCondition.wait_for(lock, m_period, [this] { return m_stop; })) {
+    diagnostic_msgs::DiagnosticArray msg;
+    msg.header.stamp = ros::Time::now();
+    msg.status.resize(1);
+    diagnostic_msgs::DiagnosticStatus& status = msg.status[0];
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = m_name;
+    status.hardware_id = m_name;
+    m_metrics.report(status);
+    m_publisher.publish(msg);
+  }
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,813 @@
+#include "motion_capture_tracking/parallel_object_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+#include "motion_capture_tracking/tracer.h"
+
+namespace motion_capture_tracking {
+
+namespace {
+
+// roll, pitch, yaw [rad] of a rotation matrix (extrinsic x-y-z)
+Eigen::Vector3f rollPitchYaw(const Eigen::Matrix3f& rotation)
+{
+  return Eigen::Vector3f(
+    std::atan2(rotation(2, 1), rotation(2, 2)),
+    std::asin(std::max(-1.0f, std::min(1.0f, -rotation(2, 0)))),
+    std::atan2(rotation(1, 0), rotation(0, 0)));
+}
+
+// interleaves the lowest 21 bits of x with two zero bits each
+uint64_t spreadBits(uint64_t x)
+{
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8) & 0x100f00f00f00f00full;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2) & 0x1249249249249249ull;
+  return x;
+}
+
+// Morton (z-order) key of the cell containing position, so that cells close
+// in space are mostly close in the order
+uint64_t mortonKey(const Eigen::Vector3f& position, float inverseCellSize)
+{
+  const int64_t offset = 1 << 20;
+  uint64_t key = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    const int64_t cell = static_cast<int64_t>(std::floor(position[axis] * inverseCellSize)) + offset;
+    key |= spreadBits(static_cast<uint64_t>(std::max<int64_t>(cell, 0))) << axis;
+  }
+  return key;
+}
+
+// a level is only left after this many frames in a row within the deadline,
+// so that it does not flap with the load
+const size_t CalmFrames = 100;
+
+libobjecttracker::Object toTrackerObject(const TrackedObject& object)
+{
+  return libobjecttracker::Object(
+    object.markerConfigurationIdx(),
+    object.dynamicsConfigurationIdx(),
+    object.transformation(),
+    object.name());
+}
+
+} // anonymous namespace
+
+ParallelObjectTracker::ParallelObjectTracker(
+  const std::vector<libobjecttracker::DynamicsConfiguration>& dynamicsConfigurations,
+  const std::vector<libobjecttracker::MarkerConfiguration>& markerConfigurations,
+  const std::vector<TrackedObject>& objects,
+  const Options& options)
+  : m_options(options)
+  , m_dynamicsConfigurations(dynamicsConfigurations)
+  , m_markerConfigurations(markerConfigurations)
+  , m_logWarn()
+  , m_tracker()
+  , m_shards()
+  , m_objects(objects)
+  , m_pool()
+  , m_order()
+  , m_candidates()
+  , m_accepted()
+  , m_recoveryQueue()
+  , m_assignedMarkers()
+  , m_assignedVoxels()
+  , m_neighbors()
+  , m_unassigned()
+  , m_unassignedVoxels()
+  , m_voxels()
+  , m_lastTime(0)
+  , m_deadline()
+  , m_maxIterations(options.maxIterations)
+  , m_numCalmFrames(0)
+  , m_predictionErrorHistogram(nullptr)
+  , m_iterationsHistogram(nullptr)
+  , m_numPredictions(0)
+  , m_numFallbacks(0)
+  , m_numConflicts(0)
+  , m_numRecoveries(0)
+  , m_numDeferrals(0)
+  , m_numDeadlineMisses(0)
+  , m_numDegradationChanges(0)
+  , m_degradation(static_cast<int>(Degradation::None))
+  , m_numPredicted(0)
+{
+  if (options.numThreads <= 1 && !options.crop && !options.fixedSizeRegistration) {
+    std::vector<libobjecttracker::Object> trackerObjects;
+    for (const auto& object : objects) {
+      trackerObjects.push_back(toTrackerObject(object));
+    }
+    m_tracker.reset(new libobjecttracker::ObjectTracker(
+      dynamicsConfigurations, markerConfigurations, trackerObjects));
+    return;
+  }
+
+  if (options.crop && options.recoveryBudget > 0) {
+    m_unassigned.reset(new pcl::PointCloud<pcl::PointXYZ>);
+    m_recoveryQueue.reserve(objects.size());
+  }
+
+  m_shards.resize(objects.size());
+  for (size_t i = 0; i < objects.size(); ++i) {
+    initShard(m_shards[i], objects[i]);
+  }
+  m_candidates.reserve(objects.size());
+  m_accepted.reserve(objects.size());
+  if (options.numThreads > 1) {
+    m_pool.reset(new ThreadPool(options.numThreads));
+    if (options.orderCellSize > 0) {
+      m_order.resize(objects.size());
+    }
+  }
+}
+
+void ParallelObjectTracker::update(pcl::PointCloud<pcl::PointXYZ>::Ptr pointCloud, double time)
+{
+  if (m_tracker) {
+    m_tracker->update(pointCloud);
+    const auto& trackerObjects = m_tracker->objects();
+    for (size_t i = 0; i < m_objects.size(); ++i) {
+      m_objects[i].setTransformation(
+        trackerObjects[i].transformation(),
+        trackerObjects[i].lastTransformationValid());
+    }
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  m_deadline = m_options.deadline > 0
+    ? start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(m_options.deadline))
+    : std::chrono::steady_clock::time_point::max();
+  m_maxIterations = degradation() >= Degradation::FewerIterations
+    ? std::min(m_options.degradedMaxIterations, m_options.maxIterations)
+    : m_options.maxIterations;
+
+  // also used for the conflicts if not cropping
+  {
+    // cells as large as the box of a tracked object, so that a query touches
+    // at most 8 cells
+    const float dt = m_lastTime > 0 && time > m_lastTime ? time - m_lastTime : 0;
+    float cellSize = 0.01f;
+    for (const auto& shard : m_shards) {
+      cellSize = std::max(cellSize, 2 * (shard.cropExtent + dt * shard.maxVelocity).maxCoeff());
+    }
+    TraceScope trace("build voxels");
+    m_voxels.build(*pointCloud, cellSize);
+  }
+  m_lastTime = time;
+
+  auto task = [&](size_t i) {
+    updateObject(i, pointCloud, time);
+  };
+  if (m_pool && !m_order.empty()) {
+    // objects that were lost are placed by their last valid pose
+    const float inverseCellSize = 1.0f / m_options.orderCellSize;
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+      m_order[i] = std::make_pair(mortonKey(m_shards[i].lastPosition, inverseCellSize), static_cast<uint32_t>(i));
+    }
+    std::sort(m_order.begin(), m_order.end());
+    auto orderedTask = [&](size_t i) {
+      updateObject(m_order[i].second, pointCloud, time);
+    };
+    m_pool->run(m_order.size(), orderedTask);
+  } else if (m_pool) {
+    m_pool->run(m_shards.size(), task);
+  } else {
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+      task(i);
+    }
+  }
+
+  m_accepted.clear();
+  resolveConflicts();
+  for (size_t i = 0; i < m_shards.size(); ++i) {
+    if (m_shards[i].solved) {
+      finishObject(i, m_objects[i].lastTransformationValid(), time);
+      m_shards[i].solved = false;
+    }
+  }
+
+  if (m_unassigned) {
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+      // objects never found keep searching from their initial pose
+      if (!m_shards[i].lost && m_shards[i].tracked && !m_objects[i].lastTransformationValid()) {
+        m_shards[i].lost = true;
+        m_recoveryQueue.push_back(i);
+      }
+    }
+    if (!m_recoveryQueue.empty()) {
+      TraceScope trace("recover objects");
+      recover(*pointCloud, time);
+    }
+  }
+
+  // statistics are gathered here, so that the workers share no cache lines
+  uint64_t numPredictions = 0;
+  uint64_t numFallbacks = 0;
+  uint64_t numPredicted = 0;
+  for (const auto& shard : m_shards) {
+    numPredicted += shard.extrapolated;
+    if (shard.predicted) {
+      ++numPredictions;
+      if (shard.fallback) {
+        ++numFallbacks;
+      } else if (m_predictionErrorHistogram) {
+        m_predictionErrorHistogram->record(shard.predictionError * 1e6f);
+      }
+    }
+    if (shard.registration && !shard.extrapolated && m_iterationsHistogram) {
+      m_iterationsHistogram->record(shard.iterations);
+    }
+  }
+  m_numPredictions.fetch_add(numPredictions, std::memory_order_relaxed);
+  m_numFallbacks.fetch_add(numFallbacks, std::memory_order_relaxed);
+  m_numPredicted.fetch_add(numPredicted, std::memory_order_relaxed);
+
+  if (m_options.deadline > 0) {
+    degrade(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+}
+
+const std::vector<TrackedObject>& ParallelObjectTracker::objects() const
+{
+  return m_objects;
+}
+
+const std::vector<libobjecttracker::MarkerConfiguration>& ParallelObjectTracker::markerConfigurations() const
+{
+  return m_markerConfigurations;
+}
+
+float ParallelObjectTracker::fitness(size_t idx) const
+{
+  return idx < m_shards.size() ? m_shards[idx].fitness : std::numeric_limits<float>::quiet_NaN();
+}
+
+int ParallelObjectTracker::iterations(size_t idx) const
+{
+  return idx < m_shards.size() ? m_shards[idx].iterations : 0;
+}
+
+void ParallelObjectTracker::setLogWarningCallback(std::function<void(const std::string&)> logWarn)
+{
+  m_logWarn = logWarn;
+  if (m_tracker) {
+    m_tracker->setLogWarningCallback(logWarn);
+  }
+  for (auto& shard : m_shards) {
+    if (shard.tracker) {
+      shard.tracker->setLogWarningCallback(logWarn);
+    }
+  }
+}
+
+bool ParallelObjectTracker::addMarkerConfiguration(
+  const libobjecttracker::MarkerConfiguration& markers,
+  size_t& idx)
+{
+  if (m_tracker) {
+    return false;
+  }
+  idx = m_markerConfigurations.size();
+  m_markerConfigurations.push_back(markers);
+  return true;
+}
+
+bool ParallelObjectTracker::addObject(const TrackedObject& object)
+{
+  if (m_tracker
+      || object.markerConfigurationIdx() >= m_markerConfigurations.size()
+      || object.dynamicsConfigurationIdx() >= m_dynamicsConfigurations.size()) {
+    return false;
+  }
+  m_objects.push_back(object);
+  m_shards.emplace_back();
+  initShard(m_shards.back(), object);
+  m_candidates.reserve(m_shards.size());
+  m_accepted.reserve(m_shards.size());
+  if (m_pool && m_options.orderCellSize > 0) {
+    m_order.resize(m_shards.size());
+  }
+  if (m_unassigned) {
+    m_recoveryQueue.reserve(m_shards.size());
+  }
+  return true;
+}
+
+bool ParallelObjectTracker::removeObject(size_t idx)
+{
+  if (m_tracker || idx >= m_objects.size()) {
+    return false;
+  }
+  m_objects.erase(m_objects.begin() + idx);
+  m_shards.erase(m_shards.begin() + idx);
+  if (m_pool && m_options.orderCellSize > 0) {
+    m_order.resize(m_shards.size());
+  }
+  // the indices of all later objects shift down by one
+  size_t numQueued = 0;
+  for (uint32_t queued : m_recoveryQueue) {
+    if (queued != idx) {
+      m_recoveryQueue[numQueued++] = queued > idx ? queued - 1 : queued;
+    }
+  }
+  m_recoveryQueue.resize(numQueued);
+  return true;
+}
+
+bool ParallelObjectTracker::resetObject(size_t idx, const Eigen::Affine3f& transformation)
+{
+  if (m_tracker || idx >= m_objects.size()) {
+    return false;
+  }
+  TrackedObject& object = m_objects[idx];
+  object = TrackedObject(
+    object.markerConfigurationIdx(),
+    object.dynamicsConfigurationIdx(),
+    transformation,
+    object.name(),
+    object.priority());
+  m_recoveryQueue.erase(
+    std::remove(m_recoveryQueue.begin(), m_recoveryQueue.end(), static_cast<uint32_t>(idx)),
+    m_recoveryQueue.end());
+  initShard(m_shards[idx], object);
+  return true;
+}
+
+void ParallelObjectTracker::setPredictionErrorHistogram(Histogram* histogram)
+{
+  m_predictionErrorHistogram = histogram;
+}
+
+void ParallelObjectTracker::setIterationsHistogram(Histogram* histogram)
+{
+  m_iterationsHistogram = histogram;
+}
+
+void ParallelObjectTracker::initShard(Shard& shard, const TrackedObject& object)
+{
+  const auto& markers = *m_markerConfigurations[object.markerConfigurationIdx()];
+  shard.dynamics = m_dynamicsConfigurations[object.dynamicsConfigurationIdx()];
+  shard.markers = m_markerConfigurations[object.markerConfigurationIdx()];
+  shard.registration.reset();
+  shard.tracker.reset();
+  if (m_options.fixedSizeRegistration) {
+    shard.registration = RigidRegistration::create(markers);
+  }
+  if (!shard.registration) {
+    shard.tracker.reset(new libobjecttracker::ObjectTracker(
+      m_dynamicsConfigurations, m_markerConfigurations, {toTrackerObject(object)}));
+    if (m_logWarn) {
+      shard.tracker->setLogWarningCallback(m_logWarn);
+    }
+  }
+
+  // the object's origin may be anywhere within its markers, so every marker
+  // can be as far away as the farthest one in any direction
+  float radius = 0;
+  for (const auto& point : markers) {
+    radius = std::max(radius, point.getVector3fMap().norm());
+  }
+  shard.radius = radius;
+  shard.cropExtent.setConstant(radius + m_options.cropMargin);
+  shard.maxVelocity = Eigen::Vector3f(
+    shard.dynamics.maxXVelocity,
+    shard.dynamics.maxYVelocity,
+    shard.dynamics.maxZVelocity);
+
+  shard.tracked = false;
+  shard.lastValidTime = 0;
+  shard.lastPosition = object.transformation().translation();
+  shard.hasVelocity = false;
+  shard.velocity.setZero();
+  shard.lost = false;
+  shard.extrapolated = false;
+  shard.solved = false;
+  shard.previousPose = object.transformation();
+  shard.hasClaims = false;
+  shard.claims.reserve(markers.size());
+  shard.predicted = false;
+  shard.fallback = false;
+  shard.predictionError = 0;
+  shard.fitness = std::numeric_limits<float>::quiet_NaN();
+  shard.iterations = 0;
+  shard.attempted = false;
+  if (!shard.cloud) {
+    shard.cloud.reset(new pcl::PointCloud<pcl::PointXYZ>);
+  }
+}
+
+void ParallelObjectTracker::updateObject(
+  size_t idx,
+  const pcl::PointCloud<pcl::PointXYZ>::Ptr& pointCloud,
+  double time)
+{
+  TraceScope trace("update object", "object", idx);
+  Shard& shard = m_shards[idx];
+  // last valid pose, or the initial one
+  const Eigen::Affine3f lastPose = m_objects[idx].transformation();
+  shard.solved = false;
+  shard.previousPose = lastPose;
+  shard.hasClaims = false;
+  shard.predicted = false;
+  shard.fallback = false;
+  shard.fitness = std::numeric_limits<float>::quiet_NaN();
+  shard.iterations = 0;
+  // left to recover()
+  if (shard.lost) {
+    return;
+  }
+  // the motion model stays at the last solved pose
+  if (extrapolate(idx)) {
+    Eigen::Affine3f pose = lastPose;
+    pose.translation() = shard.lastPosition + (time - shard.lastValidTime) * shard.velocity;
+    m_objects[idx].setTransformation(pose, true, true);
+    shard.extrapolated = true;
+    return;
+  }
+  shard.extrapolated = false;
+
+  bool valid;
+  // objects that were never found search the whole cloud
+  if (!shard.tracked || !m_options.crop) {
+    valid = track(idx, pointCloud, lastPose, time);
+  } else {
+    const float elapsed = std::max(time - shard.lastValidTime, 0.0);
+    const Eigen::Vector3f reachable = elapsed * shard.maxVelocity;
+
+    Eigen::Vector3f predictedPosition;
+    // libobjecttracker seeds itself with the last pose, and a fallback would
+    // run its ICP twice
+    if (m_options.predict && shard.hasVelocity && shard.registration) {
+      predictedPosition = shard.lastPosition + elapsed * shard.velocity;
+      const Eigen::Vector3f halfSize = shard.cropExtent
+        + reachable.cwiseMin(Eigen::Vector3f::Constant(m_options.predictionTolerance));
+      m_voxels.crop(predictedPosition - halfSize, predictedPosition + halfSize, *shard.cloud);
+      Eigen::Affine3f guess = lastPose;
+      guess.translation() = predictedPosition;
+      valid = track(idx, shard.cloud, guess, time);
+      shard.predicted = true;
+      shard.fallback = !valid;
+    }
+
+    if (!shard.predicted || shard.fallback) {
+      const Eigen::Vector3f halfSize = shard.cropExtent + reachable;
+      m_voxels.crop(shard.lastPosition - halfSize, shard.lastPosition + halfSize, *shard.cloud);
+      valid = track(idx, shard.cloud, lastPose, time);
+    } else {
+      const Eigen::Vector3f position = m_objects[idx].transformation().translation();
+      shard.predictionError = (position - predictedPosition).norm();
+    }
+  }
+  shard.solved = true;
+}
+
+void ParallelObjectTracker::recover(const pcl::PointCloud<pcl::PointXYZ>& pointCloud, double time)
+{
+  // markers of the healthy objects at their new pose
+  m_assignedMarkers.points.clear();
+  for (size_t i = 0; i < m_shards.size(); ++i) {
+    if (!m_objects[i].lastTransformationValid()) {
+      continue;
+    }
+    const Eigen::Affine3f& pose = m_objects[i].transformation();
+    for (const auto& point : m_shards[i].markers->points) {
+      const Eigen::Vector3f position = pose * point.getVector3fMap();
+      m_assignedMarkers.points.push_back(pcl::PointXYZ(position.x(), position.y(), position.z()));
+    }
+  }
+
+  const float distance = m_options.assignmentDistance;
+  m_unassigned->points.clear();
+  if (m_assignedMarkers.empty() || distance <= 0) {
+    m_unassigned->points.assign(pointCloud.points.begin(), pointCloud.points.end());
+  } else {
+    m_assignedVoxels.build(m_assignedMarkers, 2 * distance);
+    const Eigen::Vector3f extent(distance, distance, distance);
+    for (const auto& point : pointCloud.points) {
+      const Eigen::Vector3f position(point.x, point.y, point.z);
+      m_assignedVoxels.crop(position - extent, position + extent, m_neighbors);
+      if (m_neighbors.empty()) {
+        m_unassigned->points.push_back(point);
+      }
+    }
+  }
+  m_unassigned->width = m_unassigned->points.size();
+  m_unassigned->height = 1;
+  m_unassignedVoxels.build(*m_unassigned, m_voxels.cellSize());
+
+  // the objects lost most recently are the cheapest to find again, in a box
+  // that holds the fewest wrong candidates
+  std::sort(m_recoveryQueue.begin(), m_recoveryQueue.end(), [this](uint32_t a, uint32_t b) {
+    const double timeA = m_shards[a].lastValidTime;
+    const double timeB = m_shards[b].lastValidTime;
+    return timeA > timeB || (timeA == timeB && a < b);
+  });
+  for (uint32_t idx : m_recoveryQueue) {
+    m_shards[idx].attempted = false;
+  }
+  // the first object is always attempted, so that the queue moves on with
+  // any budget and even when degraded
+  auto deadline = std::chrono::steady_clock::now()
+    + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(m_options.recoveryBudget));
+  if (degradation() >= Degradation::LimitRecovery) {
+    deadline = std::min(deadline, m_deadline);
+  }
+  auto task = [&](size_t i) {
+    if (i == 0 || std::chrono::steady_clock::now() < deadline) {
+      recoverObject(m_recoveryQueue[i], time);
+    }
+  };
+  if (m_pool) {
+    m_pool->run(m_recoveryQueue.size(), task);
+  } else {
+    for (size_t i = 0; i < m_recoveryQueue.size(); ++i) {
+      task(i);
+    }
+  }
+
+  // lost objects may search the same unassigned markers; they are accepted
+  // after the healthy objects
+  resolveConflicts();
+  for (uint32_t idx : m_recoveryQueue) {
+    Shard& shard = m_shards[idx];
+    if (shard.solved) {
+      const bool valid = m_objects[idx].lastTransformationValid();
+      finishObject(idx, valid, time);
+      shard.lost = !valid;
+      shard.solved = false;
+    }
+  }
+
+  // recovered objects leave the queue
+  size_t numDeferred = 0;
+  size_t numLost = 0;
+  for (uint32_t idx : m_recoveryQueue) {
+    const Shard& shard = m_shards[idx];
+    if (!shard.attempted) {
+      ++numDeferred;
+    }
+    if (shard.lost) {
+      m_recoveryQueue[numLost++] = idx;
+    }
+  }
+  const size_t numRecovered = m_recoveryQueue.size() - numLost;
+  m_recoveryQueue.resize(numLost);
+  m_numDeferrals.fetch_add(numDeferred, std::memory_order_relaxed);
+  m_numRecoveries.fetch_add(numRecovered, std::memory_order_relaxed);
+}
+
+void ParallelObjectTracker::recoverObject(size_t idx, double time)
+{
+  TraceScope trace("recover object", "object", idx);
+  Shard& shard = m_shards[idx];
+  shard.attempted = true;
+  const Eigen::Affine3f lastPose = m_objects[idx].transformation();
+  shard.previousPose = lastPose;
+  shard.hasClaims = false;
+
+  // the uncertainty grows with the time since the last valid pose
+  const float elapsed = std::max(time - shard.lastValidTime, 0.0);
+  const Eigen::Vector3f halfSize = shard.cropExtent + elapsed * shard.maxVelocity;
+  m_unassignedVoxels.crop(shard.lastPosition - halfSize, shard.lastPosition + halfSize, *shard.cloud);
+  track(idx, shard.cloud, lastPose, time);
+  shard.solved = true;
+}
+
+void ParallelObjectTracker::resolveConflicts()
+{
+  const float distance = m_options.assignmentDistance;
+  if (distance <= 0) {
+    return;
+  }
+  m_candidates.clear();
+  for (size_t i = 0; i < m_shards.size(); ++i) {
+    if (m_shards[i].solved && m_objects[i].lastTransformationValid()) {
+      m_candidates.push_back(i);
+    }
+  }
+  // objects that continue their track first, as they are the most likely to
+  // be right, then the better fits; libobjecttracker reports no fitness
+  auto rank = [this](uint32_t idx) {
+    const Shard& shard = m_shards[idx];
+    const bool found = !shard.tracked || shard.lost;
+    const float fitness = std::isnan(shard.fitness) ? std::numeric_limits<float>::infinity() : shard.fitness;
+    return std::make_tuple(found, fitness, idx);
+  };
+  std::sort(m_candidates.begin(), m_candidates.end(), [&rank](uint32_t a, uint32_t b) {
+    return rank(a) < rank(b);
+  });
+
+  uint64_t numConflicts = 0;
+  for (uint32_t candidate : m_candidates) {
+    bool rejected = false;
+    for (uint32_t accepted : m_accepted) {
+      if (conflict(candidate, accepted)) {
+        rejected = true;
+        break;
+      }
+    }
+    if (!rejected) {
+      m_accepted.push_back(candidate);
+      continue;
+    }
+    ++numConflicts;
+    Shard& shard = m_shards[candidate];
+    TrackedObject& object = m_objects[candidate];
+    object.setTransformation(shard.previousPose, false);
+    // libobjecttracker keeps the rejected pose; it starts over from the last
+    // one
+    if (shard.tracker) {
+      shard.tracker.reset(new libobjecttracker::ObjectTracker(
+        m_dynamicsConfigurations, m_markerConfigurations, {toTrackerObject(object)}));
+      if (m_logWarn) {
+        shard.tracker->setLogWarningCallback(m_logWarn);
+      }
+    }
+  }
+  m_numConflicts.fetch_add(numConflicts, std::memory_order_relaxed);
+}
+
+bool ParallelObjectTracker::conflict(size_t a, size_t b)
+{
+  // only objects whose markers can be in reach of each other
+  const float reach = m_shards[a].radius + m_shards[b].radius + 2 * m_options.assignmentDistance;
+  const Eigen::Vector3f offset = m_objects[a].transformation().translation()
+    - m_objects[b].transformation().translation();
+  if (offset.squaredNorm() > reach * reach) {
+    return false;
+  }
+  // a claimed marker is a point of the frame, so common claims are equal
+  const auto& claimsB = claims(b);
+  size_t shared = 0;
+  for (const auto& claim : claims(a)) {
+    if (std::find(claimsB.begin(), claimsB.end(), claim) != claimsB.end()) {
+      ++shared;
+    }
+  }
+  return shared >= 2;
+}
+
+const std::vector<Eigen::Vector3f>& ParallelObjectTracker::claims(size_t idx)
+{
+  Shard& shard = m_shards[idx];
+  if (shard.hasClaims) {
+    return shard.claims;
+  }
+  shard.hasClaims = true;
+  shard.claims.clear();
+  const float distance = m_options.assignmentDistance;
+  const Eigen::Vector3f extent(distance, distance, distance);
+  const Eigen::Affine3f& pose = m_objects[idx].transformation();
+  for (const auto& point : shard.markers->points) {
+    const Eigen::Vector3f marker = pose * point.getVector3fMap();
+    m_voxels.crop(marker - extent, marker + extent, m_neighbors);
+    // missing markers claim nothing
+    float closestDistance = std::numeric_limits<float>::infinity();
+    Eigen::Vector3f closest;
+    for (const auto& neighbor : m_neighbors.points) {
+      const float squaredDistance = (neighbor.getVector3fMap() - marker).squaredNorm();
+      if (squaredDistance < closestDistance) {
+        closestDistance = squaredDistance;
+        closest = neighbor.getVector3fMap();
+      }
+    }
+    if (closestDistance < std::numeric_limits<float>::infinity()) {
+      shard.claims.push_back(closest);
+    }
+  }
+  return shard.claims;
+}
+
+void ParallelObjectTracker::finishObject(size_t idx, bool valid, double time)
+{
+  Shard& shard = m_shards[idx];
+  if (!valid) {
+    shard.hasVelocity = false;
+    return;
+  }
+
+  // constant velocity model; the velocity is estimated from the last two
+  // valid poses, within the dynamics limits
+  const Eigen::Vector3f position = m_objects[idx].transformation().translation();
+  shard.hasVelocity = shard.tracked && time > shard.lastValidTime;
+  if (shard.hasVelocity) {
+    shard.velocity = ((position - shard.lastPosition) / (time - shard.lastValidTime))
+      .cwiseMax(-shard.maxVelocity).cwiseMin(shard.maxVelocity);
+  }
+  shard.tracked = true;
+  shard.lastValidTime = time;
+  shard.lastPosition = position;
+}
+
+bool ParallelObjectTracker::extrapolate(size_t idx) const
+{
+  // every other frame at most, and only right after a valid pose
+  const Shard& shard = m_shards[idx];
+  return degradation() >= Degradation::PredictLowPriority
+    && m_objects[idx].priority() <= m_options.predictionPriority
+    && shard.hasVelocity
+    && !shard.extrapolated;
+}
+
+void ParallelObjectTracker::degrade(double duration)
+{
+  const int level = m_degradation.load(std::memory_order_relaxed);
+  int newLevel = level;
+  if (duration > m_options.deadline) {
+    m_numDeadlineMisses.fetch_add(1, std::memory_order_relaxed);
+    m_numCalmFrames = 0;
+    newLevel = std::min(level + 1, static_cast<int>(Degradation::PredictLowPriority));
+  } else if (++m_numCalmFrames >= CalmFrames) {
+    m_numCalmFrames = 0;
+    newLevel = std::max(level - 1, static_cast<int>(Degradation::None));
+  }
+
+  if (newLevel != level) {
+    m_degradation.store(newLevel, std::memory_order_relaxed);
+    m_numDegradationChanges.fetch_add(1, std::memory_order_relaxed);
+    if (m_logWarn && newLevel > level) {
+      m_logWarn("Tracking took longer than its deadline, degrading to level " + std::to_string(newLevel) + ".");
+    }
+  }
+}
+
+bool ParallelObjectTracker::track(
+  size_t idx,
+  const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
+  const Eigen::Affine3f& guess,
+  double time)
+{
+  Shard& shard = m_shards[idx];
+  TrackedObject& object = m_objects[idx];
+
+  if (shard.tracker) {
+    shard.tracker->update(cloud);
+    const auto& result = shard.tracker->objects()[0];
+    object.setTransformation(result.transformation(), result.lastTransformationValid());
+    return result.lastTransformationValid();
+  }
+
+  RigidRegistration::Result result;
+  result.iterations = 0;
+  const bool aligned = shard.registration->align(*cloud, guess, m_maxIterations, result);
+  const bool valid = aligned && validate(shard, object, result, time);
+  shard.iterations += result.iterations;
+  if (aligned) {
+    shard.fitness = result.fitness;
+  }
+  // keep the last valid pose, it is the starting point of the next attempt
+  object.setTransformation(valid ? result.transformation : object.transformation(), valid);
+  return valid;
+}
+
+bool ParallelObjectTracker::validate(
+  const Shard& shard,
+  const TrackedObject& object,
+  const RigidRegistration::Result& result,
+  double time) const
+{
+  const libobjecttracker::DynamicsConfiguration& dynamics = shard.dynamics;
+  if (result.fitness > dynamics.maxFitnessScore) {
+    return false;
+  }
+
+  const Eigen::Vector3f attitude = rollPitchYaw(result.transformation.rotation());
+  if (std::fabs(attitude.x()) > dynamics.maxRoll
+      || std::fabs(attitude.y()) > dynamics.maxPitch) {
+    return false;
+  }
+
+  // rates can only be checked against an earlier valid pose
+  const double dt = time - shard.lastValidTime;
+  if (!shard.tracked || dt <= 0) {
+    return true;
+  }
+
+  // the last solved position, the object's pose may be extrapolated
+  const Eigen::Vector3f velocity = (result.transformation.translation() - shard.lastPosition) / dt;
+  if (std::fabs(velocity.x()) > dynamics.maxXVelocity
+      || std::fabs(velocity.y()) > dynamics.maxYVelocity
+      || std::fabs(velocity.z()) > dynamics.maxZVelocity) {
+    return false;
+  }
+
+  const Eigen::Matrix3f delta = object.transformation().rotation().transpose()
+    * result.transformation.rotation();
+  const Eigen::Vector3f rates = rollPitchYaw(delta) / dt;
+  return std::fabs(rates.x()) <= dynamics.maxRollRate
+    && std::fabs(rates.y()) <= dynamics.maxPitchRate
+    && std::fabs(rates.z()) <= dynamics.maxYawRate;
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,76 @@
+#include "motion_capture_tracking/replay_frame_source.h"
+
+#include <cstdio>
+#include <thread>
+
+#include <ros/ros.h>
+
+#include "motion_capture_tracking/cloud_log.h"
+
+namespace motion_capture_tracking {
+
+ReplayFrameSource::ReplayFrameSource(
+  const std::string& path,
+  double speed)
+  : m_path(path)
+  , m_speed(speed)
+  , m_rotated(false)
+  , m_fileIdx(0)
+  , m_stream()
+  , m_started(false)
+  , m_firstMillis(0)
+  , m_startTime()
+{
+  m_stream.open(path, std::ios::binary);
+  if (!m_stream.is_open()) {
+    m_rotated = true;
+    openNextFile();
+  }
+}
+
+bool ReplayFrameSource::waitForNextFrame(Frame& frame, bool /*withPointCloud*/)
+{
+  // the cloud is read even if it is not used, to advance in the log
+  if (!frame.markers || frame.markers.use_count() > 1) {
+    frame.markers.reset(new pcl::PointCloud<pcl::PointXYZ>);
+  }
+
+  uint32_t millis;
+  while (!m_stream.is_open()
+         || !cloud_log::readRecord(m_stream, millis, *frame.markers)) {
+    if (!m_rotated || !openNextFile()) {
+      return false;
+    }
+  }
+
+  if (!m_started) {
+    m_started = true;
+    m_firstMillis = millis;
+    m_startTime = std::chrono::steady_clock::now();
+  }
+  if (m_speed > 0 && millis >= m_firstMillis) {
+    const std::chrono::duration<double> offset((millis - m_firstMillis) / 1000.0 / m_speed);
+    std::this_thread::sleep_until(m_startTime
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+  }
+
+  frame.arrivalTime = ros::Time::now();
+  frame.timestamp = static_cast<uint64_t>(millis) * 1000;
+  frame.hasMarkers = true;
+  frame.rigidBodies.clear();
+  return true;
+}
+
+bool ReplayFrameSource::openNextFile()
+{
+  char suffix[16];
+  std::snprintf(suffix, sizeof(suffix), ".%04zu", m_fileIdx);
+  ++m_fileIdx;
+
+  m_stream.close();
+  m_stream.clear();
+  m_stream.open(m_path + suffix, std::ios::binary);
+  return m_stream.is_open();
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,118 @@
+#include "motion_capture_tracking/shared_pose_writer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <ros/ros.h>
+
+namespace motion_capture_tracking {
+
+SharedPoseWriter::SharedPoseWriter()
+  : m_name()
+  , m_header(nullptr)
+  , m_size(0)
+  , m_numPoses(0)
+  , m_numDropped(0)
+{
+}
+
+SharedPoseWriter::~SharedPoseWriter()
+{
+  if (m_header) {
+    // readers that still have it mapped notice and open the next one
+    m_header->magic.store(0, std::memory_order_release);
+    ::munmap(m_header, m_size);
+    ::shm_unlink(m_name.c_str());
+  }
+}
+
+bool SharedPoseWriter::open(const std::string& name, size_t capacity)
+{
+  // a new segment, so that readers of a previous one are not confused by a
+  // change of its size
+  ::shm_unlink(name.c_str());
+  const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    ROS_ERROR("Could not create shared memory %s: %s", name.c_str(), std::strerror(errno));
+    return false;
+  }
+  const size_t size = shared_poses::segmentSize(capacity);
+  void* memory = MAP_FAILED;
+  if (::ftruncate(fd, size) == 0) {
+    memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  const int error = errno;
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    ROS_ERROR("Could not map shared memory %s: %s", name.c_str(), std::strerror(error));
+    ::shm_unlink(name.c_str());
+    return false;
+  }
+
+  // the segment is zero-filled, so readers ignore it until the magic is set
+  m_name = name;
+  m_size = size;
+  m_header = new (memory) shared_poses::Header();
+  m_header->version = shared_poses::Version;
+  m_header->capacity = capacity;
+  m_header->poseSize = sizeof(shared_poses::Pose);
+  m_header->sequence.store(0, std::memory_order_relaxed);
+  m_header->numPoses = 0;
+  m_header->magic.store(shared_poses::Magic, std::memory_order_release);
+  return true;
+}
+
+void SharedPoseWriter::begin(uint64_t frameId, uint64_t timestamp, const ros::Time& stamp)
+{
+  // odd while the frame is written; the fence keeps the writes below from
+  // becoming visible before the sequence
+  m_header->sequence.store(m_header->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_header->frameId = frameId;
+  m_header->timestamp = timestamp;
+  m_header->stamp = stamp.toNSec();
+  m_numPoses = 0;
+}
+
+void SharedPoseWriter::add(
+  uint32_t id,
+  const std::string& name,
+  const Eigen::Vector3f& position,
+  const Eigen::Quaternionf& rotation,
+  bool valid,
+  bool extrapolated)
+{
+  if (m_numPoses >= m_header->capacity) {
+    m_numDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  shared_poses::Pose& pose = shared_poses::poses(m_header)[m_numPoses++];
+  pose.id = id;
+  pose.valid = valid;
+  pose.extrapolated = extrapolated;
+  pose.reserved = 0;
+  pose.position[0] = position.x();
+  pose.position[1] = position.y();
+  pose.position[2] = position.z();
+  pose.orientation[0] = rotation.x();
+  pose.orientation[1] = rotation.y();
+  pose.orientation[2] = rotation.z();
+  pose.orientation[3] = rotation.w();
+  const size_t length = std::min(name.size(), shared_poses::NameSize - 1);
+  std::memcpy(pose.name, name.data(), length);
+  pose.name[length] = '\0';
+}
+
+void SharedPoseWriter::commit()
+{
+  m_header->numPoses = m_numPoses;
+  m_header->sequence.store(m_header->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,151 @@
+#include "motion_capture_tracking/thread_pool.h"
+
+#include "motion_capture_tracking/tracer.h"
+
+namespace motion_capture_tracking {
+
+namespace {
+
+uint64_t packRange(uint32_t begin, uint32_t end)
+{
+  return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+uint32_t rangeBegin(uint64_t range)
+{
+  return static_cast<uint32_t>(range >> 32);
+}
+
+uint32_t rangeEnd(uint64_t range)
+{
+  return static_cast<uint32_t>(range);
+}
+
+} // anonymous namespace
+
+ThreadPool::ThreadPool(size_t numThreads)
+  : m_numThreads(numThreads < 1 ? 1 : numThreads)
+  , m_ranges(new Range[m_numThreads])
+  , m_workers()
+  , m_context(nullptr)
+  , m_function(nullptr)
+  , m_pending(0)
+  , m_generation(0)
+  , m_stop(false)
+{
+  for (size_t i = 0; i < m_numThreads; ++i) {
+    m_ranges[i].value.store(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 1; i < m_numThreads; ++i) {
+    m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wakeUp.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::runImpl(size_t numTasks, void* context, TaskFunction function)
+{
+  if (numTasks == 0) {
+    return;
+  }
+  if (m_numThreads == 1 || numTasks == 1) {
+    for (size_t i = 0; i < numTasks; ++i) {
+      function(context, i);
+    }
+    return;
+  }
+
+  // Publish the task before the ranges; workers only read it after taking a
+  // task out of a range.
+  m_context = context;
+  m_function = function;
+  m_pending.store(numTasks, std::memory_order_relaxed);
+  for (size_t i = 0; i < m_numThreads; ++i) {
+    const uint32_t begin = static_cast<uint32_t>(numTasks * i / m_numThreads);
+    const uint32_t end = static_cast<uint32_t>(numTasks * (i + 1) / m_numThreads);
+    m_ranges[i].value.store(packRange(begin, end), std::memory_order_release);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+  }
+  m_wakeUp.notify_all();
+
+  work(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this] { return m_pending.load(std::memory_order_acquire) == 0; });
+}
+
+void ThreadPool::workerLoop(size_t threadIdx)
+{
+  setTraceThreadName("tracking worker");
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeUp.wait(lock, [&] { return m_stop || m_generation != generation; });
+      if (m_stop) {
+        return;
+      }
+      generation = m_generation;
+    }
+    work(threadIdx);
+  }
+}
+
+void ThreadPool::work(size_t threadIdx)
+{
+  size_t taskIdx;
+  while (takeOwn(threadIdx, taskIdx) || steal(threadIdx, taskIdx)) {
+    m_function(m_context, taskIdx);
+    if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_done.notify_all();
+    }
+  }
+}
+
+bool ThreadPool::takeOwn(size_t threadIdx, size_t& taskIdx)
+{
+  std::atomic<uint64_t>& range = m_ranges[threadIdx].value;
+  uint64_t current = range.load(std::memory_order_acquire);
+  while (rangeBegin(current) < rangeEnd(current)) {
+    if (range.compare_exchange_weak(current,
+          packRange(rangeBegin(current) + 1, rangeEnd(current)),
+          std::memory_order_acq_rel, std::memory_order_acquire)) {
+      taskIdx = rangeBegin(current);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::steal(size_t threadIdx, size_t& taskIdx)
+{
+  for (size_t i = 1; i < m_numThreads; ++i) {
+    std::atomic<uint64_t>& range = m_ranges[(threadIdx + i) % m_numThreads].value;
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (rangeBegin(current) < rangeEnd(current)) {
+      if (range.compare_exchange_weak(current,
+            packRange(rangeBegin(current), rangeEnd(current) - 1),
+            std::memory_order_acq_rel, std::memory_order_acquire)) {
+        taskIdx = rangeEnd(current) - 1;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,213 @@
+#include "motion_capture_tracking/tracer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+namespace motion_capture_tracking {
+
+namespace detail {
+
+std::atomic<bool> tracingEnabled(false);
+
+} // namespace detail
+
+namespace {
+
+struct Event
+{
+  const char* name;
+  const char* argName;
+  int64_t arg;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// Written by a single thread. Like a seqlock, started counts the events whose
+// write has begun, and finished those that are complete, so that writeTrace()
+// can tell which of the events it copied were overwritten meanwhile.
+struct Ring
+{
+  Ring(size_t capacity, uint32_t tid)
+    : events(capacity)
+    , started(0)
+    , finished(0)
+    , name(nullptr)
+    , inUse(true)
+    , tid(tid)
+  {
+  }
+
+  std::vector<Event> events;
+  std::atomic<uint64_t> started;
+  std::atomic<uint64_t> finished;
+  std::atomic<const char*> name;
+  // rings of finished threads are handed to new threads
+  std::atomic<bool> inUse;
+  const uint32_t tid;
+};
+
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<Ring>> rings;
+std::atomic<size_t> ringCapacity(0);
+
+thread_local const char* threadName = nullptr;
+
+struct ThreadRing
+{
+  ~ThreadRing()
+  {
+    if (ring) {
+      ring->inUse.store(false, std::memory_order_release);
+    }
+  }
+
+  Ring* ring = nullptr;
+};
+
+thread_local ThreadRing threadRing;
+
+Ring* acquireRing()
+{
+  const size_t capacity = ringCapacity.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  for (const auto& ring : rings) {
+    if (!ring->inUse.load(std::memory_order_acquire) && ring->events.size() == capacity) {
+      ring->inUse.store(true, std::memory_order_relaxed);
+      return ring.get();
+    }
+  }
+  rings.emplace_back(new Ring(capacity, rings.size() + 1));
+  return rings.back().get();
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+void recordTraceEvent(const char* name, const char* argName, int64_t arg, uint64_t begin, uint64_t end)
+{
+  Ring* ring = threadRing.ring;
+  if (!ring) {
+    if (ringCapacity.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    ring = threadRing.ring = acquireRing();
+    ring->name.store(threadName, std::memory_order_relaxed);
+  }
+
+  // the fence keeps the write of the event from moving before started
+  const uint64_t idx = ring->finished.load(std::memory_order_relaxed);
+  ring->started.store(idx + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  Event& event = ring->events[idx % ring->events.size()];
+  event.name = name;
+  event.argName = argName;
+  event.arg = arg;
+  event.begin = begin;
+  event.end = end;
+  ring->finished.store(idx + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+void enableTracing(size_t eventsPerThread)
+{
+  if (eventsPerThread == 0) {
+    return;
+  }
+  ringCapacity.store(eventsPerThread, std::memory_order_relaxed);
+  detail::tracingEnabled.store(true, std::memory_order_relaxed);
+}
+
+void disableTracing()
+{
+  detail::tracingEnabled.store(false, std::memory_order_relaxed);
+}
+
+void setTraceThreadName(const char* name)
+{
+  threadName = name;
+  if (threadRing.ring) {
+    threadRing.ring->name.store(name, std::memory_order_relaxed);
+  }
+}
+
+bool writeTrace(const std::string& path, size_t& numEvents)
+{
+  numEvents = 0;
+  FILE* file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    ROS_ERROR("Could not open trace %s: %s", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  const int pid = ::getpid();
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"motion_capture_tracking\"}}", pid);
+
+  // rings are never freed, so the file is written without holding the lock,
+  // which a thread recording its first event would wait for
+  std::vector<const Ring*> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (const auto& ring : rings) {
+      snapshot.push_back(ring.get());
+    }
+  }
+
+  std::vector<Event> events;
+  for (const Ring* ring : snapshot) {
+    const size_t capacity = ring->events.size();
+    const uint64_t finished = ring->finished.load(std::memory_order_acquire);
+    const uint64_t first = finished > capacity ? finished - capacity : 0;
+    events.clear();
+    for (uint64_t i = first; i < finished; ++i) {
+      events.push_back(ring->events[i % capacity]);
+    }
+    // events the thread started to overwrite while they were copied are
+    // dropped
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t started = ring->started.load(std::memory_order_relaxed);
+    const uint64_t firstIntact = started > capacity ? started - capacity : 0;
+    const size_t numOverwritten = std::min<uint64_t>(std::max(firstIntact, first) - first, events.size());
+
+    const char* name = ring->name.load(std::memory_order_relaxed);
+    std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+      pid, ring->tid, name ? name : "unnamed");
+    for (size_t i = numOverwritten; i < events.size(); ++i) {
+      const Event& event = events[i];
+      // in us, as expected by the format
+      const uint64_t duration = event.end - event.begin;
+      std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+        "\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64 ".%03u",
+        event.name, pid, ring->tid,
+        event.begin / 1000, static_cast<unsigned>(event.begin % 1000),
+        duration / 1000, static_cast<unsigned>(duration % 1000));
+      if (event.argName) {
+        std::fprintf(file, ",\"args\":{\"%s\":%" PRId64 "}", event.argName, event.arg);
+      }
+      std::fprintf(file, "}");
+    }
+    numEvents += events.size() - numOverwritten;
+  }
+  std::fprintf(file, "\n]}\n");
+
+  const bool failed = std::ferror(file);
+  if (std::fclose(file) != 0 || failed) {
+    ROS_ERROR("Could not write trace %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace motion_capture_tracking
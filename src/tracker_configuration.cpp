@@ -0,0 +1,213 @@
+#include "motion_capture_tracking/tracker_configuration.h"
+
+#include <sstream>
+
+#include <ros/ros.h>
+
+namespace motion_capture_tracking {
+
+namespace {
+
+// Looks up parent[key], logging an error with the full parameter name if it
+// is missing or of a different type.
+XmlRpc::XmlRpcValue* member(
+  XmlRpc::XmlRpcValue& parent,
+  const std::string& key,
+  const std::string& path)
+{
+  if (parent.getType() != XmlRpc::XmlRpcValue::TypeStruct || !parent.hasMember(key)) {
+    ROS_ERROR("Parameter %s%s is missing!", path.c_str(), key.c_str());
+    return nullptr;
+  }
+  return &parent[key];
+}
+
+bool toFloat(
+  XmlRpc::XmlRpcValue& value,
+  const std::string& name,
+  float& result)
+{
+  if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble) {
+    result = static_cast<double>(value);
+  } else if (value.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+    result = static_cast<int>(value);
+  } else {
+    ROS_ERROR("Parameter %s is not a number!", name.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool getFloat(
+  XmlRpc::XmlRpcValue& parent,
+  const std::string& key,
+  const std::string& path,
+  float& result)
+{
+  XmlRpc::XmlRpcValue* value = member(parent, key, path);
+  return value && toFloat(*value, path + key, result);
+}
+
+bool getInt(
+  XmlRpc::XmlRpcValue& parent,
+  const std::string& key,
+  const std::string& path,
+  int& result)
+{
+  XmlRpc::XmlRpcValue* value = member(parent, key, path);
+  if (!value) {
+    return false;
+  }
+  if (value->getType() != XmlRpc::XmlRpcValue::TypeInt) {
+    ROS_ERROR("Parameter %s%s is not an integer!", path.c_str(), key.c_str());
+    return false;
+  }
+  result = static_cast<int>(*value);
+  return true;
+}
+
+// Reads an array of numbers of the given size
+bool getVector(
+  XmlRpc::XmlRpcValue& parent,
+  const std::string& key,
+  const std::string& path,
+  int size,
+  float* result)
+{
+  XmlRpc::XmlRpcValue* value = member(parent, key, path);
+  if (!value) {
+    return false;
+  }
+  if (value->getType() != XmlRpc::XmlRpcValue::TypeArray || value->size() != size) {
+    ROS_ERROR("Parameter %s%s is not an array of %d numbers!", path.c_str(), key.c_str(), size);
+    return false;
+  }
+  for (int i = 0; i < size; ++i) {
+    if (!toFloat((*value)[i], path + key, result[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string indexKey(int i)
+{
+  std::stringstream sstr;
+  sstr << i;
+  return sstr.str();
+}
+
+} // namespace
+
+bool TrackerConfiguration::parse(XmlRpc::XmlRpcValue& params)
+{
+  dynamicsConfigurations.clear();
+  markerConfigurations.clear();
+  objects.clear();
+
+  int numConfigurations;
+  if (!getInt(params, "numDynamicsConfigurations", "", numConfigurations)) {
+    return false;
+  }
+  XmlRpc::XmlRpcValue* yamlDynamics = member(params, "dynamicsConfigurations", "");
+  if (numConfigurations > 0 && !yamlDynamics) {
+    return false;
+  }
+  dynamicsConfigurations.resize(numConfigurations);
+  for (int i = 0; i < numConfigurations; ++i) {
+    const std::string path = "dynamicsConfigurations/" + indexKey(i) + "/";
+    XmlRpc::XmlRpcValue* yamlConfiguration = member(*yamlDynamics, indexKey(i), "dynamicsConfigurations/");
+    if (!yamlConfiguration) {
+      return false;
+    }
+    libobjecttracker::DynamicsConfiguration& configuration = dynamicsConfigurations[i];
+    if (!getFloat(*yamlConfiguration, "maxXVelocity", path, configuration.maxXVelocity)
+        || !getFloat(*yamlConfiguration, "maxYVelocity", path, configuration.maxYVelocity)
+        || !getFloat(*yamlConfiguration, "maxZVelocity", path, configuration.maxZVelocity)
+        || !getFloat(*yamlConfiguration, "maxPitchRate", path, configuration.maxPitchRate)
+        || !getFloat(*yamlConfiguration, "maxRollRate", path, configuration.maxRollRate)
+        || !getFloat(*yamlConfiguration, "maxYawRate", path, configuration.maxYawRate)
+        || !getFloat(*yamlConfiguration, "maxRoll", path, configuration.maxRoll)
+        || !getFloat(*yamlConfiguration, "maxPitch", path, configuration.maxPitch)
+        || !getFloat(*yamlConfiguration, "maxFitnessScore", path, configuration.maxFitnessScore)) {
+      return false;
+    }
+  }
+
+  if (!getInt(params, "numMarkerConfigurations", "", numConfigurations)) {
+    return false;
+  }
+  XmlRpc::XmlRpcValue* yamlMarkers = member(params, "markerConfigurations", "");
+  if (numConfigurations > 0 && !yamlMarkers) {
+    return false;
+  }
+  for (int i = 0; i < numConfigurations; ++i) {
+    const std::string path = "markerConfigurations/" + indexKey(i) + "/";
+    XmlRpc::XmlRpcValue* yamlConfiguration = member(*yamlMarkers, indexKey(i), "markerConfigurations/");
+    int numPoints;
+    float offset[3];
+    if (!yamlConfiguration
+        || !getInt(*yamlConfiguration, "numPoints", path, numPoints)
+        || !getVector(*yamlConfiguration, "offset", path, 3, offset)) {
+      return false;
+    }
+    XmlRpc::XmlRpcValue* yamlPoints = member(*yamlConfiguration, "points", path);
+    if (numPoints > 0 && !yamlPoints) {
+      return false;
+    }
+    markerConfigurations.push_back(pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>));
+    for (int j = 0; j < numPoints; ++j) {
+      float point[3];
+      if (!getVector(*yamlPoints, indexKey(j), path + "points/", 3, point)) {
+        return false;
+      }
+      markerConfigurations.back()->push_back(pcl::PointXYZ(point[0] + offset[0], point[1] + offset[1], point[2] + offset[2]));
+    }
+  }
+
+  XmlRpc::XmlRpcValue* yamlObjects = member(params, "objects", "");
+  if (!yamlObjects) {
+    return false;
+  }
+  if (yamlObjects->getType() != XmlRpc::XmlRpcValue::TypeArray) {
+    ROS_ERROR("Parameter objects is not a list!");
+    return false;
+  }
+  for (int32_t i = 0; i < yamlObjects->size(); ++i) {
+    const std::string path = "objects/" + indexKey(i) + "/";
+    XmlRpc::XmlRpcValue& yamlObject = (*yamlObjects)[i];
+    XmlRpc::XmlRpcValue* name = member(yamlObject, "name", path);
+    if (!name) {
+      return false;
+    }
+    if (name->getType() != XmlRpc::XmlRpcValue::TypeString) {
+      ROS_ERROR("Parameter %sname is not a string!", path.c_str());
+      return false;
+    }
+    float position[3];
+    int markerConfigurationIdx;
+    int dynamicsConfigurationIdx;
+    if (!getVector(yamlObject, "initialPosition", path, 3, position)
+        || !getInt(yamlObject, "markerConfiguration", path, markerConfigurationIdx)
+        || !getInt(yamlObject, "dynamicsConfiguration", path, dynamicsConfigurationIdx)) {
+      return false;
+    }
+    if (markerConfigurationIdx < 0 || markerConfigurationIdx >= (int)markerConfigurations.size()
+        || dynamicsConfigurationIdx < 0 || dynamicsConfigurationIdx >= (int)dynamicsConfigurations.size()) {
+      ROS_ERROR("Object %s refers to an unknown marker or dynamics configuration!",
+        static_cast<const std::string&>(*name).c_str());
+      return false;
+    }
+    // optional
+    int priority = 0;
+    if (yamlObject.hasMember("priority") && !getInt(yamlObject, "priority", path, priority)) {
+      return false;
+    }
+    Eigen::Affine3f m;
+    m = Eigen::Translation3f(position[0], position[1], position[2]);
+    objects.push_back(TrackedObject(markerConfigurationIdx, dynamicsConfigurationIdx, m, *name, priority));
+  }
+  return true;
+}
+
+} // namespace motion_capture_tracking
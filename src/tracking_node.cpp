@@ -0,0 +1,1084 @@
+#include "motion_capture_tracking/tracking_node.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include <libmotioncapture/motioncapture.h>
+#include <libobjecttracker/object_tracker.h>
+
+#include "motion_capture_tracking/allocation_counter.h"
+#include "motion_capture_tracking/point_cloud_conversion.h"
+#include "motion_capture_tracking/replay_frame_source.h"
+#include "motion_capture_tracking/tracer.h"
+#include "motion_capture_tracking/tracked_object.h"
+#include "motion_capture_tracking/tracker_configuration.h"
+
+namespace motion_capture_tracking {
+
+namespace {
+
+void logWarn(const std::string& msg)
+{
+  ROS_WARN("%s", msg.c_str());
+}
+
+std::unique_ptr<ParallelObjectTracker> createObjectTracker(ros::NodeHandle& nl)
+{
+  // all parameters in a single round-trip to the parameter server
+  XmlRpc::XmlRpcValue params;
+  if (!nl.getParam(nl.getNamespace(), params)) {
+    ROS_ERROR("Could not read the parameters of %s!", nl.getNamespace().c_str());
+    return nullptr;
+  }
+  TrackerConfiguration configuration;
+  if (!configuration.parse(params)) {
+    return nullptr;
+  }
+
+  ParallelObjectTracker::Options options;
+  // 0 or 1: track all objects on the main thread
+  int trackingThreads;
+  nl.param<int>("tracking_threads", trackingThreads, 0);
+  options.numThreads = std::max(trackingThreads, 0);
+  nl.param<bool>("tracking_crop", options.crop, false);
+  double cropMargin;
+  nl.param<double>("tracking_crop_margin", cropMargin, 0.05);
+  options.cropMargin = cropMargin;
+  nl.param<bool>("tracking_prediction", options.predict, false);
+  double predictionTolerance;
+  nl.param<double>("tracking_prediction_tolerance", predictionTolerance, 0.01);
+  options.predictionTolerance = predictionTolerance;
+  // marker configurations of 3 to 6 points skip PCL's ICP
+  nl.param<bool>("tracking_fixed_size_registration", options.fixedSizeRegistration, false);
+  double orderCellSize;
+  nl.param<double>("tracking_order_cell_size", orderCellSize, 1.0);
+  options.orderCellSize = orderCellSize;
+  nl.param<double>("tracking_recovery_budget", options.recoveryBudget, 0.0);
+  double assignmentDistance;
+  nl.param<double>("tracking_assignment_distance", assignmentDistance, 0.01);
+  options.assignmentDistance = assignmentDistance;
+  // 0: never degrade
+  nl.param<double>("tracking_deadline", options.deadline, 0.0);
+  nl.param<int>("tracking_degraded_max_iterations", options.degradedMaxIterations, 3);
+  nl.param<int>("tracking_prediction_priority", options.predictionPriority, 0);
+
+  std::unique_ptr<ParallelObjectTracker> tracker(
+    new ParallelObjectTracker(
+      configuration.dynamicsConfigurations,
+      configuration.markerConfigurations,
+      configuration.objects,
+      options));
+  tracker->setLogWarningCallback(logWarn);
+  return tracker;
+}
+
+// Returns false if the parameters are invalid; filter stays empty if no
+// stage is enabled.
+bool createMarkerFilter(
+  ros::NodeHandle& nl,
+  const ParallelObjectTracker& tracker,
+  std::unique_ptr<MarkerFilter>& filter)
+{
+  MarkerFilter::Options options;
+  std::vector<double> box;
+  nl.param<std::vector<double> >("marker_filter_box", box, std::vector<double>());
+  if (!box.empty()) {
+    if (box.size() != 6) {
+      ROS_ERROR("marker_filter_box must be [min x, min y, min z, max x, max y, max z]!");
+      return false;
+    }
+    options.boxMin = Eigen::Vector3f(box[0], box[1], box[2]);
+    options.boxMax = Eigen::Vector3f(box[3], box[4], box[5]);
+  }
+  std::vector<double> polygon;
+  nl.param<std::vector<double> >("marker_filter_polygon", polygon, std::vector<double>());
+  if (!polygon.empty() && (polygon.size() % 2 != 0 || polygon.size() < 6)) {
+    ROS_ERROR("marker_filter_polygon must be a list of at least 3 x, y pairs!");
+    return false;
+  }
+  for (size_t i = 0; i + 1 < polygon.size(); i += 2) {
+    options.polygon.push_back(Eigen::Vector2f(polygon[i], polygon[i + 1]));
+  }
+  int staticFrames;
+  nl.param<int>("marker_filter_static_frames", staticFrames, 0);
+  options.staticFrames = std::max(staticFrames, 0);
+  double staticCellSize;
+  nl.param<double>("marker_filter_static_cell_size", staticCellSize, 0.02);
+  options.staticCellSize = staticCellSize;
+  // objects wait at their initial position until they are tracked, and their
+  // markers are within the extent of their marker configuration
+  double protectMargin;
+  nl.param<double>("marker_filter_protect_margin", protectMargin, 0.05);
+  for (const auto& object : tracker.objects()) {
+    float radius = 0;
+    for (const auto& point : tracker.markerConfigurations()[object.markerConfigurationIdx()]->points) {
+      radius = std::max(radius, point.getVector3fMap().norm());
+    }
+    options.protectedPositions.push_back(object.transformation().translation());
+    options.protectedRadii.push_back(radius + protectMargin);
+  }
+  double minDistance;
+  nl.param<double>("marker_filter_min_distance", minDistance, 0.0);
+  options.minDistance = minDistance;
+  if (options.staticCellSize <= 0) {
+    ROS_ERROR("marker_filter_static_cell_size must be positive!");
+    return false;
+  }
+
+  filter.reset(new MarkerFilter(options));
+  if (!filter->enabled()) {
+    filter.reset();
+  }
+  return true;
+}
+
+} // namespace
+
+TrackingNode::TrackingNode(
+  const ros::NodeHandle& n,
+  const ros::NodeHandle& nl)
+  : m_n(n)
+  , m_nl(nl)
+  , m_stop(false)
+  , m_acquisition()
+  , m_mergedSource(nullptr)
+  , m_frameMonitor()
+  , m_useLibObjectTracker(true)
+  , m_replay(false)
+  , m_lastDropped(0)
+  , m_lastTimestamp(0)
+  , m_lastArrivalTime()
+  , m_pubPointCloud()
+  , m_usePointCloud2(false)
+  , m_pointCloudDecimation(1)
+  , m_pointCloudHeader()
+  , m_msgPointCloud()
+  , m_msgPointCloud2()
+  , m_pointCloudLogger()
+  , m_asyncCloudLogger()
+  , m_markerFilter()
+  , m_tracker()
+  , m_clockMapper()
+  , m_mocapLatency(0)
+  , m_replayStartStamp()
+  , m_replayStartTimestamp(0)
+  , m_publishTf(true)
+  , m_pubTf()
+  , m_transforms("world")
+  , m_publishPoses(true)
+  , m_pubPoses()
+  , m_posesSeq(0)
+  , m_msgPoses()
+  , m_sharedPoses()
+  , m_trackingLogger()
+  , m_objectNames()
+  , m_objectIds()
+  , m_rigidBodyIds()
+  , m_frameRigidBodyIds()
+  , m_changedObjectNamesMutex()
+  , m_changedObjectNames()
+  , m_objectNamesChanged(false)
+  , m_publishObjectNamesMutex()
+  , m_objectNamesTimer()
+  , m_commandsMutex()
+  , m_commandsCondition()
+  , m_commands()
+  , m_services()
+  , m_metrics()
+  , m_allocationsHistogram(nullptr)
+  , m_trackerAllocationsHistogram(nullptr)
+  , m_tracePath()
+  , m_replayTrackerHistogram("tracker time", "us")
+  , m_replayStopwatch()
+  , m_metricsReporter()
+{
+  m_pointCloudHeader.seq = 0;
+  m_pointCloudHeader.frame_id = "world";
+}
+
+TrackingNode::~TrackingNode()
+{
+  m_metricsReporter.reset();
+  m_asyncCloudLogger.reset();
+  m_trackingLogger.reset();
+  if (m_pointCloudLogger) {
+    m_pointCloudLogger->flush();
+  }
+}
+
+bool TrackingNode::initialize()
+{
+  std::string motionCaptureType, motionCaptureHostname;
+  m_nl.param<std::string>("motion_capture_type", motionCaptureType, "vicon");
+  m_nl.param<std::string>("motion_capture_hostname", motionCaptureHostname, "localhost");
+
+  std::string objectTrackingType;
+  m_nl.param<std::string>("object_tracking_type", objectTrackingType, "libobjecttracker");
+  if (objectTrackingType == "libobjecttracker") {
+    m_useLibObjectTracker = true;
+  } else if (objectTrackingType == "motionCapture") {
+    m_useLibObjectTracker = false;
+  } else {
+    ROS_ERROR("Unknown object_tracking_type '%s'! Use one of motionCapture,libobjecttracker.", objectTrackingType.c_str());
+    return false;
+  }
+
+  // Make a new client, or play back a point cloud log
+  std::unique_ptr<FrameSource> source;
+  XmlRpc::XmlRpcValue yamlSources;
+  m_replay = motionCaptureType == "replay";
+  double replaySpeed = 1.0;
+  if (m_replay) {
+    std::string replayPath;
+    m_nl.param<std::string>("replay_path", replayPath, "");
+    // 1: real time, 0: as fast as possible
+    m_nl.param<double>("replay_speed", replaySpeed, 1.0);
+    replaySpeed = std::max(replaySpeed, 0.0);
+    ReplayFrameSource* replaySource = new ReplayFrameSource(replayPath, replaySpeed);
+    source.reset(replaySource);
+    if (!replaySource->valid()) {
+      ROS_ERROR("Could not open point cloud log '%s'!", replayPath.c_str());
+      return false;
+    }
+  } else if (m_nl.getParam("motion_capture_sources", yamlSources)) {
+    // several systems, merged into a single point cloud
+    if (!m_useLibObjectTracker) {
+      ROS_ERROR("motion_capture_sources can only be merged with object_tracking_type libobjecttracker!");
+      return false;
+    }
+    if (yamlSources.getType() != XmlRpc::XmlRpcValue::TypeArray || yamlSources.size() == 0) {
+      ROS_ERROR("motion_capture_sources must be a list of sources!");
+      return false;
+    }
+    std::vector<std::unique_ptr<FrameSource> > sources;
+    for (int32_t i = 0; i < yamlSources.size(); ++i) {
+      XmlRpc::XmlRpcValue& yamlSource = yamlSources[i];
+      if (yamlSource.getType() != XmlRpc::XmlRpcValue::TypeStruct
+          || !yamlSource.hasMember("type") || !yamlSource.hasMember("hostname")
+          || yamlSource["type"].getType() != XmlRpc::XmlRpcValue::TypeString
+          || yamlSource["hostname"].getType() != XmlRpc::XmlRpcValue::TypeString) {
+        ROS_ERROR("motion_capture_sources/%d needs a type and a hostname!", i);
+        return false;
+      }
+      const std::string type = yamlSource["type"];
+      const std::string hostname = yamlSource["hostname"];
+      libmotioncapture::MotionCapture *mocap = libmotioncapture::MotionCapture::connect(type, hostname);
+      sources.emplace_back(new MocapFrameSource(mocap, false));
+    }
+    MergedFrameSource::Options options;
+    m_nl.param<double>("merge_max_skew", options.maxSkew, 0.005);
+    double duplicateDistance;
+    m_nl.param<double>("merge_duplicate_distance", duplicateDistance, 0.005);
+    options.duplicateDistance = duplicateDistance;
+    m_mergedSource = new MergedFrameSource(std::move(sources), options);
+    source.reset(m_mergedSource);
+  } else {
+    libmotioncapture::MotionCapture *mocap = libmotioncapture::MotionCapture::connect(motionCaptureType, motionCaptureHostname);
+    source.reset(new MocapFrameSource(mocap, !m_useLibObjectTracker));
+  }
+  if (!m_useLibObjectTracker && !source->supportsObjectTracking()) {
+    ROS_ERROR("Motion capture type '%s' does not support object tracking! Use object_tracking_type libobjecttracker.", motionCaptureType.c_str());
+    return false;
+  }
+
+  // frames are acquired on their own thread, so that a slow tracker does not
+  // stall the motion capture SDK
+  int frameQueueSize;
+  m_nl.param<int>("frame_queue_size", frameQueueSize, 8);
+  std::string frameQueuePolicy;
+  m_nl.param<std::string>("frame_queue_policy", frameQueuePolicy, "drop_oldest");
+  typedef FrameAcquisition::FrameQueue FrameQueue;
+  FrameQueue::OverflowPolicy overflowPolicy;
+  if (frameQueuePolicy == "drop_oldest") {
+    overflowPolicy = FrameQueue::OverflowPolicy::DropOldest;
+  } else if (frameQueuePolicy == "block") {
+    overflowPolicy = FrameQueue::OverflowPolicy::Block;
+  } else {
+    ROS_ERROR("Unknown frame_queue_policy '%s'! Use one of drop_oldest,block.", frameQueuePolicy.c_str());
+    return false;
+  }
+  // a benchmark replay must not lose frames
+  if (m_replay && replaySpeed == 0) {
+    overflowPolicy = FrameQueue::OverflowPolicy::Block;
+  }
+  m_acquisition.reset(new FrameAcquisition(std::move(source), std::max(frameQueueSize, 2), overflowPolicy));
+
+  // the stream is lost if no frame arrives for this many nominal intervals;
+  // not checked for replays, whose pace is up to the replay speed
+  double streamTimeoutFactor;
+  m_nl.param<double>("stream_timeout_factor", streamTimeoutFactor, 2.0);
+  m_frameMonitor = FrameMonitor(std::max(streamTimeoutFactor, 1.0));
+
+  // prepare point cloud publisher
+  std::string pointCloudType;
+  m_nl.param<std::string>("point_cloud_type", pointCloudType, "PointCloud");
+  if (pointCloudType == "PointCloud") {
+    m_usePointCloud2 = false;
+    m_pubPointCloud = m_nl.advertise<sensor_msgs::PointCloud>("pointCloud", 1);
+  } else if (pointCloudType == "PointCloud2") {
+    m_usePointCloud2 = true;
+    m_pubPointCloud = m_nl.advertise<sensor_msgs::PointCloud2>("pointCloud", 1);
+  } else {
+    ROS_ERROR("Unknown point_cloud_type '%s'! Use one of PointCloud,PointCloud2.", pointCloudType.c_str());
+    return false;
+  }
+
+  // only every Nth frame is published, the cloud is for visualization only
+  m_nl.param<int>("point_cloud_decimation", m_pointCloudDecimation, 1);
+  m_pointCloudDecimation = std::max(m_pointCloudDecimation, 1);
+
+  std::string save_point_clouds_path;
+  m_nl.param<std::string>("save_point_clouds_path", save_point_clouds_path, "");
+  if (!save_point_clouds_path.empty()) {
+    // writes clouds on a background thread instead of keeping them in memory
+    bool saveCloudsAsync;
+    m_nl.param<bool>("save_point_clouds_async", saveCloudsAsync, false);
+    if (saveCloudsAsync) {
+      AsyncCloudLogger::Options options;
+      options.path = save_point_clouds_path;
+      int queueSize;
+      m_nl.param<int>("save_point_clouds_queue_size", queueSize, 256);
+      options.queueSize = std::max(queueSize, 2);
+      double maxFileSize;
+      m_nl.param<double>("save_point_clouds_max_file_size", maxFileSize, 0.0);
+      options.maxFileSize = std::max(maxFileSize, 0.0) * 1024 * 1024;
+      m_nl.param<double>("save_point_clouds_max_file_duration", options.maxFileDuration, 0.0);
+      m_asyncCloudLogger.reset(new AsyncCloudLogger(options));
+    } else {
+      m_pointCloudLogger.reset(new libobjecttracker::PointCloudLogger(save_point_clouds_path));
+    }
+  }
+
+  // prepare object tracker
+  if (m_useLibObjectTracker) {
+    m_tracker = createObjectTracker(m_nl);
+    if (!m_tracker || !createMarkerFilter(m_nl, *m_tracker, m_markerFilter)) {
+      return false;
+    }
+  }
+
+  // outputs are stamped with the acquisition time, estimated by mapping the
+  // mocap timestamps to ROS time and subtracting a known fixed latency
+  m_nl.param<double>("mocap_latency", m_mocapLatency, 0.0);
+
+  // instrumentation, published periodically on /diagnostics
+  m_frameIntervalHistogram = &m_metrics.histogram("frame interval", "us");
+  m_acquisitionHistogram = &m_metrics.histogram("acquisition time", "us");
+  m_queueHistogram = &m_metrics.histogram("queue time", "us");
+  m_filterHistogram = &m_metrics.histogram("marker filter time", "us");
+  m_trackerHistogram = &m_metrics.histogram("tracker time", "us");
+  m_publishHistogram = &m_metrics.histogram("publish time", "us");
+  m_latencyHistogram = &m_metrics.histogram("latency", "us");
+  m_markersHistogram = &m_metrics.histogram("markers", "count");
+  m_validObjectsHistogram = &m_metrics.histogram("valid objects", "count");
+  m_framesCounter = &m_metrics.counter("frames tracked");
+  m_frameGapsCounter = &m_metrics.counter("frame gaps");
+  m_streamLossesCounter = &m_metrics.counter("stream losses");
+  m_tfSkippedCounter = &m_metrics.counter("tf transforms skipped");
+  m_nominalIntervalGauge = &m_metrics.gauge("nominal frame interval [us]");
+  m_clockOffsetGauge = &m_metrics.gauge("clock offset [s]");
+  m_clockDriftGauge = &m_metrics.gauge("clock drift [ppm]");
+  m_receptionDelayGauge = &m_metrics.gauge("reception delay [s]");
+  m_clockResetsGauge = &m_metrics.gauge("clock resets");
+  FrameAcquisition* acquisition = m_acquisition.get();
+  m_metrics.addCallback("frames acquired", [acquisition] { return acquisition->numPushed(); });
+  m_metrics.addCallback("frames dropped", [acquisition] { return acquisition->numDropped(); });
+  m_metrics.addCallback("frames blocked", [acquisition] { return acquisition->numBlocked(); });
+  if (countingAllocations()) {
+    m_allocationsHistogram = &m_metrics.histogram("allocations per frame", "count");
+    m_trackerAllocationsHistogram = &m_metrics.histogram("tracker allocations per frame", "count");
+  }
+  if (m_tracker) {
+    auto tracker = m_tracker.get();
+    tracker->setPredictionErrorHistogram(&m_metrics.histogram("prediction error", "um"));
+    tracker->setIterationsHistogram(&m_metrics.histogram("registration iterations", "count"));
+    m_metrics.addCallback("tracker predictions", [tracker] { return tracker->numPredictions(); });
+    m_metrics.addCallback("tracker fallbacks", [tracker] { return tracker->numFallbacks(); });
+    m_metrics.addCallback("tracker conflicts", [tracker] { return tracker->numConflicts(); });
+    m_metrics.addCallback("tracker recoveries", [tracker] { return tracker->numRecoveries(); });
+    m_metrics.addCallback("tracker recovery deferrals", [tracker] { return tracker->numDeferrals(); });
+    m_metrics.addCallback("tracker deadline misses", [tracker] { return tracker->numDeadlineMisses(); });
+    m_metrics.addCallback("tracker degradation changes", [tracker] { return tracker->numDegradationChanges(); });
+    m_metrics.addCallback("tracker degradation level", [tracker] { return static_cast<int>(tracker->degradation()); });
+    m_metrics.addCallback("tracker poses predicted", [tracker] { return tracker->numPredicted(); });
+  }
+  if (m_markerFilter) {
+    auto filter = m_markerFilter.get();
+    m_metrics.addCallback("markers outside volume", [filter] { return filter->numOutside(); });
+    m_metrics.addCallback("static markers", [filter] { return filter->numStatic(); });
+    m_metrics.addCallback("markers too close", [filter] { return filter->numDuplicates(); });
+  }
+  if (m_mergedSource) {
+    auto mergedSource = m_mergedSource;
+    m_metrics.addCallback("frames merged", [mergedSource] { return mergedSource->numMerged(); });
+    m_metrics.addCallback("frames not merged", [mergedSource] { return mergedSource->numSkipped(); });
+    m_metrics.addCallback("duplicate markers", [mergedSource] { return mergedSource->numDuplicates(); });
+  }
+  if (m_asyncCloudLogger) {
+    auto logger = m_asyncCloudLogger.get();
+    m_metrics.addCallback("clouds logged", [logger] { return logger->numWritten(); });
+    m_metrics.addCallback("clouds dropped from log", [logger] { return logger->numDropped(); });
+  }
+
+  // the latest poses in shared memory, for consumers on the same host; see
+  // SharedPoseReader
+  std::string sharedMemoryName;
+  m_nl.param<std::string>("shared_memory_name", sharedMemoryName, "");
+  if (!sharedMemoryName.empty()) {
+    int sharedMemoryCapacity;
+    m_nl.param<int>("shared_memory_capacity", sharedMemoryCapacity, 256);
+    m_sharedPoses.reset(new SharedPoseWriter);
+    if (sharedMemoryCapacity <= 0 || !m_sharedPoses->open(sharedMemoryName, sharedMemoryCapacity)) {
+      ROS_ERROR("Could not set up shared_memory_name %s with shared_memory_capacity %d!",
+        sharedMemoryName.c_str(), sharedMemoryCapacity);
+      return false;
+    }
+    auto sharedPoses = m_sharedPoses.get();
+    m_metrics.addCallback("shared memory poses dropped", [sharedPoses] { return sharedPoses->numDropped(); });
+  }
+
+  // the output of every frame, for analysis without replaying; see
+  // tracking_log.h
+  std::string saveTrackingPath;
+  m_nl.param<std::string>("save_tracking_path", saveTrackingPath, "");
+  if (!saveTrackingPath.empty()) {
+    AsyncTrackingLogger::Options options;
+    options.path = saveTrackingPath;
+    int capacity;
+    m_nl.param<int>("save_tracking_capacity", capacity, 64);
+    options.capacity = std::max(capacity, 1);
+    m_trackingLogger.reset(new AsyncTrackingLogger(options));
+    auto logger = m_trackingLogger.get();
+    m_metrics.addCallback("tracking frames logged", [logger] { return logger->numWritten(); });
+    m_metrics.addCallback("tracking frames dropped from log", [logger] { return logger->numDropped(); });
+    m_metrics.addCallback("objects not logged", [logger] { return logger->numObjectsDropped(); });
+  }
+
+  // the stages of every frame, for chrome://tracing; written on ~write_trace
+  // and on shutdown. See tracer.h
+  int traceCapacity;
+  m_nl.param<int>("trace_capacity", traceCapacity, 0);
+  m_nl.param<std::string>("trace_path", m_tracePath, "");
+  if (traceCapacity > 0) {
+    enableTracing(traceCapacity);
+  }
+
+  double metricsPeriod;
+  m_nl.param<double>("metrics_period", metricsPeriod, 1.0);
+  if (metricsPeriod > 0) {
+    m_metricsReporter.reset(new MetricsReporter(
+      m_metrics, m_n, m_nl.getNamespace(), metricsPeriod));
+  }
+
+  // prepare TF broadcaster; same topic and queue size as
+  // tf2_ros::TransformBroadcaster
+  m_nl.param<bool>("publish_tf", m_publishTf, true);
+  if (m_publishTf) {
+    m_pubTf = m_n.advertise<tf2_msgs::TFMessage>("/tf", 100);
+  }
+  // objects at rest are only sent at the keep-alive rate; 0 sends all
+  double tfMinTranslation;
+  double tfMinRotation;
+  double tfKeepAlivePeriod;
+  m_nl.param<double>("tf_min_translation", tfMinTranslation, 0.0);
+  m_nl.param<double>("tf_min_rotation", tfMinRotation, 0.0);
+  m_nl.param<double>("tf_keep_alive_period", tfKeepAlivePeriod, 1.0);
+  m_transforms.setChangeThresholds(tfMinTranslation, tfMinRotation, tfKeepAlivePeriod);
+
+  // all poses of a frame in one compact message, objects are identified by
+  // their index in ~object_names. Subscribers may ask for UDPROS with
+  // ros::TransportHints().udp() for the lowest latency.
+  m_nl.param<bool>("publish_poses", m_publishPoses, true);
+  if (m_publishPoses) {
+    m_pubPoses = m_nl.advertise<NamedPoseArray>("poses", 1);
+  }
+  if (m_tracker) {
+    for (const auto& object : m_tracker->objects()) {
+      m_objectIds.push_back(m_objectNames.size());
+      m_objectNames.push_back(object.name());
+    }
+  }
+  m_nl.setParam("object_names", m_objectNames);
+  // rigid bodies seen for the first time are named by run()
+  if (!m_useLibObjectTracker) {
+    m_objectNamesTimer = m_nl.createWallTimer(ros::WallDuration(0.1), &TrackingNode::publishObjectNamesTimer, this);
+  }
+
+  if (m_tracker && m_tracker->supportsChanges()) {
+    m_services.push_back(m_nl.advertiseService("add_marker_configuration", &TrackingNode::addMarkerConfiguration, this));
+    m_services.push_back(m_nl.advertiseService("add_object", &TrackingNode::addObject, this));
+    m_services.push_back(m_nl.advertiseService("remove_object", &TrackingNode::removeObject, this));
+    m_services.push_back(m_nl.advertiseService("reset_object", &TrackingNode::resetObject, this));
+  }
+  m_services.push_back(m_nl.advertiseService("write_trace", &TrackingNode::writeTrace, this));
+
+  return true;
+}
+
+void TrackingNode::run()
+{
+  setTraceThreadName("tracking");
+  m_replayStopwatch.restart();
+  m_acquisition->setWithPointCloud(needPointCloud());
+  m_acquisition->start();
+
+  Frame frame;
+  while (ros::ok() && !m_stop.load()) {
+    checkStream();
+    runCommands();
+
+    // wake up in time to notice a stalled stream, and at least every 100 ms
+    // to notice a shutdown
+    std::chrono::microseconds timeout(100000);
+    if (!m_replay && !m_frameMonitor.lost()) {
+      const auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+        m_frameMonitor.timeUntilStall(FrameMonitor::Clock::now()));
+      if (left.count() > 0 && left < timeout) {
+        timeout = left;
+      }
+    }
+
+    // Get a frame
+    if (!m_acquisition->pop(frame, timeout)) {
+      if (m_acquisition->finished()) {
+        break;
+      }
+      continue;
+    }
+    processFrame(frame);
+
+    // only pull the point cloud if it is actually used
+    m_acquisition->setWithPointCloud(needPointCloud());
+  }
+
+  m_acquisition->stop(std::chrono::seconds(1));
+  printSummary();
+
+  size_t numEvents;
+  if (tracingEnabled() && !m_tracePath.empty() && motion_capture_tracking::writeTrace(m_tracePath, numEvents)) {
+    ROS_INFO("Wrote %zu trace events to %s.", numEvents, m_tracePath.c_str());
+  }
+}
+
+void TrackingNode::stop()
+{
+  m_stop = true;
+}
+
+bool TrackingNode::needPointCloud() const
+{
+  // the vendor solves the poses in motionCapture mode
+  return m_useLibObjectTracker
+    || m_pointCloudLogger || m_asyncCloudLogger
+    || m_pubPointCloud.getNumSubscribers() > 0;
+}
+
+void TrackingNode::checkStream()
+{
+  if (m_replay || !m_frameMonitor.checkStall(FrameMonitor::Clock::now())) {
+    return;
+  }
+  m_streamLossesCounter->increment();
+  ROS_WARN_THROTTLE(1.0, "No frame for %.1f ms (nominal interval %.1f ms); motion capture stream lost.",
+    m_frameMonitor.lastGap() / 1e3, m_frameMonitor.nominalInterval() / 1e3);
+}
+
+void TrackingNode::processFrame(Frame& frame)
+{
+  TraceScope trace("process frame", "frame", frame.frameId);
+  const uint64_t allocationsBefore = numAllocations();
+  const uint64_t timestamp = frame.timestamp;
+  ROS_DEBUG_NAMED("frames", "frame %lu: %lu", frame.frameId, timestamp);
+  const int64_t queueTime = (ros::Time::now() - frame.arrivalTime).toNSec() / 1000;
+  m_acquisitionHistogram->record(frame.acquisitionTime);
+  m_queueHistogram->record(queueTime);
+  uint64_t interval = 0;
+  if (timestamp != 0 && m_lastTimestamp != 0 && timestamp > m_lastTimestamp) {
+    interval = timestamp - m_lastTimestamp;
+  } else if (timestamp == 0 && !m_lastArrivalTime.isZero()) {
+    interval = (frame.arrivalTime - m_lastArrivalTime).toNSec() / 1000;
+  }
+  if (interval != 0) {
+    m_frameIntervalHistogram->record(interval);
+  }
+  m_lastTimestamp = timestamp;
+  m_lastArrivalTime = frame.arrivalTime;
+
+  // gaps in the stream, by the mocap clock if available
+  const bool wasLost = m_frameMonitor.lost();
+  const bool gap = m_frameMonitor.frame(interval,
+    FrameMonitor::Clock::now() - std::chrono::microseconds(std::max<int64_t>(queueTime, 0)));
+  m_nominalIntervalGauge->set(m_frameMonitor.nominalInterval());
+  if (wasLost) {
+    ROS_INFO("Motion capture stream is back after %.3f s.", m_frameMonitor.lastGap() / 1e6);
+  } else if (gap) {
+    ROS_WARN_THROTTLE(1.0, "Gap of %.1f ms in the motion capture stream (nominal interval %.1f ms).",
+      m_frameMonitor.lastGap() / 1e3, m_frameMonitor.nominalInterval() / 1e3);
+  }
+  if (gap) {
+    m_frameGapsCounter->increment();
+  }
+
+  const uint64_t dropped = m_acquisition->numDropped();
+  if (dropped != m_lastDropped) {
+    ROS_WARN_THROTTLE(1.0, "Tracking is too slow; dropped %lu frame(s) so far.", dropped);
+    m_lastDropped = dropped;
+  }
+
+  // some motion capture systems do not provide timestamps
+  ros::Time stamp = frame.arrivalTime;
+  if (m_replay && frame.timestamp != 0) {
+    // at any other speed than 1, the mapper would take every frame for a jump
+    // of the mocap clock
+    if (m_replayStartStamp.isZero()) {
+      m_replayStartStamp = frame.arrivalTime;
+      m_replayStartTimestamp = frame.timestamp;
+    }
+    const int64_t sinceStart = static_cast<int64_t>(frame.timestamp - m_replayStartTimestamp);
+    stamp = m_replayStartStamp + ros::Duration(sinceStart / 1e6);
+  } else if (frame.timestamp != 0) {
+    m_clockMapper.update(frame.timestamp, frame.arrivalTime);
+    stamp = m_clockMapper.map(frame.timestamp) - ros::Duration(m_mocapLatency);
+    m_clockOffsetGauge->set(m_clockMapper.offset());
+    m_clockDriftGauge->set(m_clockMapper.drift());
+    m_receptionDelayGauge->set(m_clockMapper.lastDelay());
+    m_clockResetsGauge->set(m_clockMapper.numResets());
+  }
+
+  auto& markers = frame.markers;
+
+  Stopwatch publishStopwatch;
+  uint64_t publishTime = 0;
+  if (frame.hasMarkers) {
+    m_markersHistogram->record(markers->size());
+
+    // publish as pointcloud
+    if (frame.frameId % m_pointCloudDecimation == 0
+        && m_pubPointCloud.getNumSubscribers() > 0) {
+      publishPointCloud(frame, stamp);
+    }
+
+    publishTime += publishStopwatch.elapsedUs();
+
+    TraceScope trace("log point cloud");
+    if (m_asyncCloudLogger) {
+      m_asyncCloudLogger->log(timestamp/1000, *markers);
+    } else if (m_pointCloudLogger) {
+      m_pointCloudLogger->log(timestamp/1000, markers);
+    }
+  }
+
+  // all transforms of a frame go out in a single tf message, all poses in
+  // a single pose array
+  if (m_publishPoses) {
+    // intraprocess subscribers may still hold the previous message
+    if (!m_msgPoses || !m_msgPoses.unique()) {
+      m_msgPoses.reset(new NamedPoseArray);
+      m_msgPoses->header.frame_id = "world";
+      m_msgPoses->poses.reserve(m_objectNames.size());
+    }
+    m_msgPoses->poses.clear();
+  }
+  size_t numValidObjects = 0;
+  size_t numUnchangedTransforms = 0;
+  if (m_trackingLogger) {
+    m_trackingLogger->begin(frame.frameId, timestamp, stamp, frame.hasMarkers ? markers->size() : 0);
+  }
+
+  if (!m_useLibObjectTracker) {
+    // poses are solved by the motion capture system
+    m_frameRigidBodyIds.resize(frame.rigidBodies.size());
+    for (size_t i = 0; i < frame.rigidBodies.size(); ++i) {
+      const auto& rigidBody = frame.rigidBodies[i];
+      if (!rigidBody.occluded()) {
+        ++numValidObjects;
+        // the id, unlike the index in the frame, is stable across frames
+        auto it = m_rigidBodyIds.find(rigidBody.name());
+        if (it == m_rigidBodyIds.end()) {
+          it = m_rigidBodyIds.emplace(rigidBody.name(), m_objectNames.size()).first;
+          m_objectNames.push_back(rigidBody.name());
+          objectNamesChanged();
+        }
+        const uint32_t id = it->second;
+        m_frameRigidBodyIds[i] = id;
+        if (m_publishTf && !m_transforms.add(id, rigidBody.name(), stamp, rigidBody.position(), rigidBody.rotation())) {
+          ++numUnchangedTransforms;
+        }
+        if (m_publishPoses) {
+          addPose(id, rigidBody.position(), rigidBody.rotation(), false);
+        }
+        if (m_trackingLogger) {
+          m_trackingLogger->add(id, rigidBody.name(), rigidBody.position(), rigidBody.rotation(), true, false,
+            std::numeric_limits<float>::quiet_NaN(), 0);
+        }
+      }
+    }
+  } else {
+    // run tracker
+    // the tracker's velocity limits refer to the mocap clock, if available
+    const double frameTime = timestamp != 0 ? timestamp / 1e6 : frame.arrivalTime.toSec();
+    const uint64_t trackerAllocationsBefore = numAllocations();
+    if (m_markerFilter && frame.hasMarkers) {
+      TraceScope trace("filter markers");
+      Stopwatch filterStopwatch;
+      m_markerFilter->filter(*markers);
+      m_filterHistogram->record(filterStopwatch.elapsedUs());
+    }
+    Stopwatch trackerStopwatch;
+    {
+      TraceScope trace("track");
+      m_tracker->update(markers, frameTime);
+    }
+    const uint64_t trackerTime = trackerStopwatch.elapsedUs();
+    m_trackerHistogram->record(trackerTime);
+    m_replayTrackerHistogram.record(trackerTime);
+    if (m_trackerAllocationsHistogram) {
+      m_trackerAllocationsHistogram->record(numAllocations() - trackerAllocationsBefore);
+    }
+
+    const auto& objects = m_tracker->objects();
+    for (size_t i = 0; i < objects.size(); ++i) {
+      const auto& object = objects[i];
+      if (m_trackingLogger) {
+        const auto& transform = object.transformation();
+        m_trackingLogger->add(m_objectIds[i], object.name(), transform.translation(),
+          Eigen::Quaternionf(transform.rotation()), object.lastTransformationValid(),
+          object.lastTransformationExtrapolated(), m_tracker->fitness(i), m_tracker->iterations(i));
+      }
+      if (object.lastTransformationValid()) {
+        const auto& transform = object.transformation();
+        const Eigen::Quaternionf rotation(transform.rotation());
+        ++numValidObjects;
+        if (m_publishTf && !m_transforms.add(m_objectIds[i], object.name(), stamp, transform.translation(), rotation)) {
+          ++numUnchangedTransforms;
+        }
+        if (m_publishPoses) {
+          addPose(m_objectIds[i], transform.translation(), rotation, object.lastTransformationExtrapolated());
+        }
+      }
+    }
+  }
+
+  publishStopwatch.restart();
+  // same-host consumers first
+  if (m_sharedPoses) {
+    TraceScope trace("write shared poses");
+    writeSharedPoses(frame, timestamp, stamp);
+  }
+  if (!m_transforms.empty()) {
+    TraceScope trace("publish tf");
+    m_pubTf.publish(m_transforms.message());
+  }
+  // published even if empty, so that subscribers see every frame
+  if (m_publishPoses && m_pubPoses.getNumSubscribers() > 0) {
+    TraceScope trace("publish poses");
+    m_msgPoses->header.seq = ++m_posesSeq;
+    m_msgPoses->header.stamp = stamp;
+    m_pubPoses.publish(m_msgPoses);
+  }
+  publishTime += publishStopwatch.elapsedUs();
+  m_publishHistogram->record(publishTime);
+  if (m_trackingLogger) {
+    m_trackingLogger->commit();
+  }
+  m_validObjectsHistogram->record(numValidObjects);
+  if (numUnchangedTransforms > 0) {
+    m_tfSkippedCounter->increment(numUnchangedTransforms);
+  }
+  m_transforms.clear();
+  m_framesCounter->increment();
+
+  // end-to-end latency, from acquisition until everything is published
+  m_latencyHistogram->record(std::max<int64_t>((ros::Time::now() - stamp).toNSec() / 1000, 0));
+  if (m_allocationsHistogram) {
+    m_allocationsHistogram->record(numAllocations() - allocationsBefore);
+  }
+}
+
+void TrackingNode::publishPointCloud(const Frame& frame, const ros::Time& stamp)
+{
+  TraceScope trace("publish point cloud");
+  m_pointCloudHeader.seq += 1;
+  m_pointCloudHeader.stamp = stamp;
+  // Published as shared pointer: intraprocess (nodelet) subscribers receive
+  // this very message, so it is only reused once nobody holds on to it
+  // anymore.
+  if (m_usePointCloud2) {
+    if (!m_msgPointCloud2 || !m_msgPointCloud2.unique()) {
+      m_msgPointCloud2.reset(new sensor_msgs::PointCloud2);
+    }
+    m_msgPointCloud2->header = m_pointCloudHeader;
+    {
+      TraceScope trace("convert point cloud");
+      toPointCloud2(*frame.markers, *m_msgPointCloud2);
+    }
+    m_pubPointCloud.publish(m_msgPointCloud2);
+  } else {
+    if (!m_msgPointCloud || !m_msgPointCloud.unique()) {
+      m_msgPointCloud.reset(new sensor_msgs::PointCloud);
+    }
+    m_msgPointCloud->header = m_pointCloudHeader;
+    {
+      TraceScope trace("convert point cloud");
+      toPointCloud(*frame.markers, *m_msgPointCloud);
+    }
+    m_pubPointCloud.publish(m_msgPointCloud);
+  }
+}
+
+void TrackingNode::writeSharedPoses(const Frame& frame, uint64_t timestamp, const ros::Time& stamp)
+{
+  // readers spin while the sequence is odd, so nothing but the copies happens
+  // between begin() and commit()
+  m_sharedPoses->begin(frame.frameId, timestamp, stamp);
+  if (!m_useLibObjectTracker) {
+    for (size_t i = 0; i < frame.rigidBodies.size(); ++i) {
+      const auto& rigidBody = frame.rigidBodies[i];
+      if (!rigidBody.occluded()) {
+        m_sharedPoses->add(m_frameRigidBodyIds[i], rigidBody.name(), rigidBody.position(), rigidBody.rotation(),
+          true, false);
+      }
+    }
+  } else {
+    const auto& objects = m_tracker->objects();
+    for (size_t i = 0; i < objects.size(); ++i) {
+      const auto& object = objects[i];
+      const auto& transform = object.transformation();
+      m_sharedPoses->add(m_objectIds[i], object.name(), transform.translation(),
+        Eigen::Quaternionf(transform.rotation()), object.lastTransformationValid(),
+        object.lastTransformationExtrapolated());
+    }
+  }
+  m_sharedPoses->commit();
+}
+
+void TrackingNode::addPose(
+  uint32_t id,
+  const Eigen::Vector3f& position,
+  const Eigen::Quaternionf& rotation,
+  bool extrapolated)
+{
+  m_msgPoses->poses.emplace_back();
+  auto& pose = m_msgPoses->poses.back();
+  pose.id = id;
+  pose.position.x = position.x();
+  pose.position.y = position.y();
+  pose.position.z = position.z();
+  pose.orientation.x = rotation.x();
+  pose.orientation.y = rotation.y();
+  pose.orientation.z = rotation.z();
+  pose.orientation.w = rotation.w();
+  pose.extrapolated = extrapolated;
+}
+
+void TrackingNode::printSummary()
+{
+  ROS_INFO("Acquired %lu frames, dropped %lu, blocked on %lu.",
+    m_acquisition->numPushed(), m_acquisition->numDropped(), m_acquisition->numBlocked());
+  if (m_replay) {
+    const double elapsed = m_replayStopwatch.elapsedUs() / 1e6;
+    const uint64_t numFrames = m_framesCounter->value();
+    ROS_INFO("Replayed %lu frames in %.3f s (%.1f frames/s).",
+      numFrames, elapsed, elapsed > 0 ? numFrames / elapsed : 0.0);
+    if (m_useLibObjectTracker) {
+      const auto summary = m_replayTrackerHistogram.collect();
+      ROS_INFO("Tracker time [us]: mean %.1f, p50 %lu, p90 %lu, p99 %lu, max %lu.",
+        summary.mean, summary.p50, summary.p90, summary.p99, summary.max);
+    }
+  }
+}
+
+bool TrackingNode::runBetweenFrames(const std::function<void()>& command)
+{
+  Command pending{command, false};
+  std::unique_lock<std::mutex> lock(m_commandsMutex);
+  m_commands.push_back(&pending);
+  if (m_commandsCondition.wait_for(lock, std::chrono::seconds(1), [&pending] { return pending.done; })) {
+    return true;
+  }
+  // e.g., run() has not started yet or has returned already
+  m_commands.erase(std::remove(m_commands.begin(), m_commands.end(), &pending), m_commands.end());
+  return false;
+}
+
+void TrackingNode::runCommands()
+{
+  std::lock_guard<std::mutex> lock(m_commandsMutex);
+  if (m_commands.empty()) {
+    return;
+  }
+  for (Command* command : m_commands) {
+    command->apply();
+    command->done = true;
+  }
+  m_commands.clear();
+  m_commandsCondition.notify_all();
+}
+
+bool TrackingNode::addMarkerConfiguration(
+  AddMarkerConfiguration::Request& req,
+  AddMarkerConfiguration::Response& res)
+{
+  if (req.points.empty()) {
+    res.message = "A marker configuration needs at least one marker.";
+    return true;
+  }
+  libobjecttracker::MarkerConfiguration markers(new pcl::PointCloud<pcl::PointXYZ>);
+  for (const auto& point : req.points) {
+    markers->push_back(pcl::PointXYZ(point.x, point.y, point.z));
+  }
+  const bool done = runBetweenFrames([&] {
+    size_t idx;
+    if (m_tracker->addMarkerConfiguration(markers, idx)) {
+      res.index = idx;
+      res.success = true;
+    }
+  });
+  if (!done) {
+    res.message = "The tracking loop is not running.";
+  } else if (res.success) {
+    ROS_INFO("Added marker configuration %d with %zu markers.", res.index, req.points.size());
+  }
+  return true;
+}
+
+bool TrackingNode::addObject(AddObject::Request& req, AddObject::Response& res)
+{
+  const bool done = runBetweenFrames([&] {
+    if (findObject(req.name) >= 0) {
+      res.message = "Object " + req.name + " is tracked already.";
+      return;
+    }
+    Eigen::Affine3f transformation;
+    transformation = Eigen::Translation3f(req.initial_position.x, req.initial_position.y, req.initial_position.z);
+    if (req.marker_configuration < 0 || req.dynamics_configuration < 0
+        || !m_tracker->addObject(TrackedObject(req.marker_configuration, req.dynamics_configuration, transformation, req.name, req.priority))) {
+      res.message = "Object " + req.name + " refers to an unknown marker or dynamics configuration.";
+      return;
+    }
+    res.id = objectId(req.name);
+    m_objectIds.push_back(res.id);
+    objectNamesChanged();
+    res.success = true;
+  });
+  if (!done) {
+    res.message = "The tracking loop is not running.";
+  } else if (res.success) {
+    // before the response, so that the caller can look up the id
+    publishObjectNames();
+    ROS_INFO("Added object %s with id %u.", req.name.c_str(), res.id);
+  }
+  return true;
+}
+
+bool TrackingNode::removeObject(RemoveObject::Request& req, RemoveObject::Response& res)
+{
+  const bool done = runBetweenFrames([&] {
+    const int idx = findObject(req.name);
+    if (idx < 0) {
+      res.message = "Object " + req.name + " is not tracked.";
+      return;
+    }
+    m_tracker->removeObject(idx);
+    m_objectIds.erase(m_objectIds.begin() + idx);
+    res.success = true;
+  });
+  if (!done) {
+    res.message = "The tracking loop is not running.";
+  } else if (res.success) {
+    ROS_INFO("Removed object %s.", req.name.c_str());
+  }
+  return true;
+}
+
+bool TrackingNode::resetObject(ResetObject::Request& req, ResetObject::Response& res)
+{
+  const bool done = runBetweenFrames([&] {
+    const int idx = findObject(req.name);
+    if (idx < 0) {
+      res.message = "Object " + req.name + " is not tracked.";
+      return;
+    }
+    Eigen::Affine3f transformation;
+    transformation = Eigen::Translation3f(req.initial_position.x, req.initial_position.y, req.initial_position.z);
+    m_tracker->resetObject(idx, transformation);
+    res.success = true;
+  });
+  if (!done) {
+    res.message = "The tracking loop is not running.";
+  } else if (res.success) {
+    ROS_INFO("Reset object %s.", req.name.c_str());
+  }
+  return true;
+}
+
+bool TrackingNode::writeTrace(WriteTrace::Request& req, WriteTrace::Response& res)
+{
+  // safe while frames are tracked
+  const std::string path = req.path.empty() ? m_tracePath : req.path;
+  size_t numEvents;
+  if (!tracingEnabled()) {
+    res.message = "Tracing is disabled; set trace_capacity.";
+  } else if (path.empty()) {
+    res.message = "No path given, and trace_path is not set.";
+  } else if (!motion_capture_tracking::writeTrace(path, numEvents)) {
+    res.message = "Could not write " + path + ".";
+  } else {
+    res.success = true;
+    res.message = "Wrote " + std::to_string(numEvents) + " events to " + path + ".";
+    ROS_INFO("%s", res.message.c_str());
+  }
+  return true;
+}
+
+int TrackingNode::findObject(const std::string& name) const
+{
+  const auto& objects = m_tracker->objects();
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (objects[i].name() == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+uint32_t TrackingNode::objectId(const std::string& name)
+{
+  // names keep their id, so that subscribers can keep ~object_names cached
+  const auto it = std::find(m_objectNames.begin(), m_objectNames.end(), name);
+  if (it != m_objectNames.end()) {
+    return it - m_objectNames.begin();
+  }
+  m_objectNames.push_back(name);
+  return m_objectNames.size() - 1;
+}
+
+void TrackingNode::objectNamesChanged()
+{
+  std::lock_guard<std::mutex> lock(m_changedObjectNamesMutex);
+  m_changedObjectNames = m_objectNames;
+  m_objectNamesChanged = true;
+}
+
+void TrackingNode::publishObjectNames()
+{
+  std::lock_guard<std::mutex> publishLock(m_publishObjectNamesMutex);
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(m_changedObjectNamesMutex);
+    if (!m_objectNamesChanged) {
+      return;
+    }
+    names.swap(m_changedObjectNames);
+    m_objectNamesChanged = false;
+  }
+  m_nl.setParam("object_names", names);
+}
+
+void TrackingNode::publishObjectNamesTimer(const ros::WallTimerEvent&)
+{
+  publishObjectNames();
+}
+
+} // namespace motion_capture_tracking
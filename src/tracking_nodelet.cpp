@@ -0,0 +1,48 @@
+#include <memory>
+#include <thread>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "motion_capture_tracking/tracking_node.h"
+
+namespace motion_capture_tracking {
+
+// The TrackingNode as a nodelet. Other nodelets in the same manager receive
+// the point clouds and poses as shared pointers, without serialization.
+//
+// The tracking loop blocks on the motion capture system, so it runs on its own
+// thread instead of the manager's callback threads.
+class TrackingNodelet : public nodelet::Nodelet
+{
+public:
+  virtual ~TrackingNodelet()
+  {
+    if (m_node) {
+      m_node->stop();
+    }
+    if (m_thread.joinable()) {
+      m_thread.join();
+    }
+  }
+
+private:
+  virtual void onInit()
+  {
+    m_node.reset(new TrackingNode(getNodeHandle(), getPrivateNodeHandle()));
+    if (!m_node->initialize()) {
+      NODELET_ERROR("Could not initialize motion capture tracking.");
+      m_node.reset();
+      return;
+    }
+    m_thread = std::thread([this] { m_node->run(); });
+  }
+
+private:
+  std::unique_ptr<TrackingNode> m_node;
+  std::thread m_thread;
+};
+
+} // namespace motion_capture_tracking
+
+PLUGINLIB_EXPORT_CLASS(motion_capture_tracking::TrackingNodelet, nodelet::Nodelet)
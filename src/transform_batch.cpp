@@ -0,0 +1,94 @@
+#include "motion_capture_tracking/transform_batch.h"
+
+#include <cmath>
+#include <utility>
+
+namespace motion_capture_tracking {
+
+TransformBatch::TransformBatch(const std::string& frameId)
+  : m_frameId(frameId)
+  , m_minTranslationSquared(0)
+  , m_maxRotationCos(1)
+  , m_keepAlivePeriod()
+  , m_skipUnchanged(false)
+  , m_slots()
+  , m_slotIndices()
+  , m_message()
+{
+}
+
+void TransformBatch::setChangeThresholds(double translation, double rotation, double keepAlivePeriod)
+{
+  m_minTranslationSquared = translation * translation;
+  m_maxRotationCos = std::cos(rotation / 2);
+  m_keepAlivePeriod = ros::Duration(keepAlivePeriod);
+  m_skipUnchanged = translation > 0 || rotation > 0;
+}
+
+bool TransformBatch::add(
+  size_t slot,
+  const std::string& childFrameId,
+  const ros::Time& stamp,
+  const Eigen::Vector3f& position,
+  const Eigen::Quaternionf& rotation)
+{
+  if (slot >= m_slots.size()) {
+    m_slots.resize(slot + 1);
+    m_slotIndices.reserve(m_slots.size());
+    m_message.transforms.reserve(m_slots.size());
+  }
+
+  // slots that were never sent have a zero stamp
+  if (m_skipUnchanged) {
+    const geometry_msgs::TransformStamped& last = m_slots[slot];
+    const auto& t = last.transform.translation;
+    const auto& q = last.transform.rotation;
+    const double dx = position.x() - t.x;
+    const double dy = position.y() - t.y;
+    const double dz = position.z() - t.z;
+    const double dot = rotation.x() * q.x + rotation.y() * q.y + rotation.z() * q.z + rotation.w() * q.w;
+    if (!last.header.stamp.isZero()
+        && stamp >= last.header.stamp
+        && stamp - last.header.stamp < m_keepAlivePeriod
+        && dx * dx + dy * dy + dz * dz <= m_minTranslationSquared
+        && std::fabs(dot) >= m_maxRotationCos
+        && last.child_frame_id == childFrameId) {
+      return false;
+    }
+  }
+
+  // default-constructed messages hold empty strings, so neither the
+  // emplace_back() nor the later destruction allocates
+  m_message.transforms.emplace_back();
+  geometry_msgs::TransformStamped& transform = m_message.transforms.back();
+  std::swap(transform, m_slots[slot]);
+  m_slotIndices.push_back(slot);
+
+  // assignments reuse the capacity of the strings
+  if (transform.header.frame_id != m_frameId) {
+    transform.header.frame_id = m_frameId;
+  }
+  if (transform.child_frame_id != childFrameId) {
+    transform.child_frame_id = childFrameId;
+  }
+  transform.header.stamp = stamp;
+  transform.transform.translation.x = position.x();
+  transform.transform.translation.y = position.y();
+  transform.transform.translation.z = position.z();
+  transform.transform.rotation.x = rotation.x();
+  transform.transform.rotation.y = rotation.y();
+  transform.transform.rotation.z = rotation.z();
+  transform.transform.rotation.w = rotation.w();
+  return true;
+}
+
+void TransformBatch::clear()
+{
+  for (size_t i = 0; i < m_slotIndices.size(); ++i) {
+    std::swap(m_message.transforms[i], m_slots[m_slotIndices[i]]);
+  }
+  m_message.transforms.clear();
+  m_slotIndices.clear();
+}
+
+} // namespace motion_capture_tracking
@@ -0,0 +1,186 @@
+#include "motion_capture_tracking/voxel_hash.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace motion_capture_tracking {
+
+namespace {
+
+// cell coordinates are stored with 21 bits per axis
+const int64_t CoordinateBits = 21;
+const int64_t CoordinateOffset = int64_t(1) << (CoordinateBits - 1);
+const int64_t CoordinateMax = (int64_t(1) << CoordinateBits) - 1;
+
+const uint32_t InvalidCell = ~uint32_t(0);
+
+bool inBox(
+  const pcl::PointXYZ& point,
+  const Eigen::Vector3f& min,
+  const Eigen::Vector3f& max)
+{
+  return point.x >= min.x() && point.x <= max.x()
+    && point.y >= min.y() && point.y <= max.y()
+    && point.z >= min.z() && point.z <= max.z();
+}
+
+} // anonymous namespace
+
+VoxelHash::VoxelHash()
+  : m_cloud(nullptr)
+  , m_cellSize(1)
+  , m_inverseCellSize(1)
+  , m_cells()
+  , m_mask(0)
+  , m_stamp(0)
+  , m_occupied()
+  , m_pointCells()
+  , m_order()
+{
+}
+
+void VoxelHash::build(const pcl::PointCloud<pcl::PointXYZ>& cloud, float cellSize)
+{
+  m_cloud = &cloud;
+  m_cellSize = cellSize;
+  m_inverseCellSize = 1.0f / cellSize;
+
+  // keep the load factor below 1/2; the table only ever grows
+  size_t capacity = 16;
+  while (capacity < 2 * cloud.size()) {
+    capacity <<= 1;
+  }
+  if (capacity > m_cells.size()) {
+    m_cells.assign(capacity, Cell{0, 0, 0, 0});
+    m_mask = capacity - 1;
+    m_stamp = 0;
+  }
+  // a new stamp empties the table without touching it
+  if (++m_stamp == 0) {
+    for (auto& cell : m_cells) {
+      cell.stamp = 0;
+    }
+    m_stamp = 1;
+  }
+  m_occupied.clear();
+
+  // count the points per cell
+  m_pointCells.resize(cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    const pcl::PointXYZ& point = cloud[i];
+    if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+      m_pointCells[i] = InvalidCell;
+      continue;
+    }
+    const size_t idx = insert(key(coordinate(point.x), coordinate(point.y), coordinate(point.z)));
+    ++m_cells[idx].end;
+    m_pointCells[i] = idx;
+  }
+
+  // turn the counts into ranges and sort the points into them
+  uint32_t offset = 0;
+  for (uint32_t idx : m_occupied) {
+    Cell& cell = m_cells[idx];
+    const uint32_t count = cell.end;
+    cell.begin = offset;
+    cell.end = offset;
+    offset += count;
+  }
+  m_order.resize(offset);
+  for (size_t i = 0; i < cloud.size(); ++i) {
+    if (m_pointCells[i] != InvalidCell) {
+      m_order[m_cells[m_pointCells[i]].end++] = i;
+    }
+  }
+}
+
+void VoxelHash::crop(
+  const Eigen::Vector3f& min,
+  const Eigen::Vector3f& max,
+  pcl::PointCloud<pcl::PointXYZ>& result) const
+{
+  result.clear();
+  if (!m_cloud) {
+    return;
+  }
+  const pcl::PointCloud<pcl::PointXYZ>& cloud = *m_cloud;
+
+  const int64_t lowX = coordinate(min.x()), highX = coordinate(max.x());
+  const int64_t lowY = coordinate(min.y()), highY = coordinate(max.y());
+  const int64_t lowZ = coordinate(min.z()), highZ = coordinate(max.z());
+  const double numCells = double(highX - lowX + 1) * (highY - lowY + 1) * (highZ - lowZ + 1);
+
+  // large boxes are cheaper to answer by looking at every point
+  if (numCells > m_order.size()) {
+    for (uint32_t i : m_order) {
+      if (inBox(cloud[i], min, max)) {
+        result.push_back(cloud[i]);
+      }
+    }
+    return;
+  }
+
+  for (int64_t x = lowX; x <= highX; ++x) {
+    for (int64_t y = lowY; y <= highY; ++y) {
+      for (int64_t z = lowZ; z <= highZ; ++z) {
+        const Cell* cell = find(key(x, y, z));
+        if (!cell) {
+          continue;
+        }
+        for (uint32_t j = cell->begin; j < cell->end; ++j) {
+          const pcl::PointXYZ& point = cloud[m_order[j]];
+          if (inBox(point, min, max)) {
+            result.push_back(point);
+          }
+        }
+      }
+    }
+  }
+}
+
+uint64_t VoxelHash::key(int64_t x, int64_t y, int64_t z) const
+{
+  return (uint64_t(x) << (2 * CoordinateBits))
+    | (uint64_t(y) << CoordinateBits)
+    | uint64_t(z);
+}
+
+int64_t VoxelHash::coordinate(float value) const
+{
+  const float cell = std::floor(value * m_inverseCellSize);
+  if (!(cell > -CoordinateOffset)) {
+    return 0;
+  }
+  return std::min<int64_t>(static_cast<int64_t>(cell) + CoordinateOffset, CoordinateMax);
+}
+
+size_t VoxelHash::insert(uint64_t key)
+{
+  size_t idx = ((key * 0x9E3779B97F4A7C15ull) >> 32) & m_mask;
+  while (m_cells[idx].stamp == m_stamp) {
+    if (m_cells[idx].key == key) {
+      return idx;
+    }
+    idx = (idx + 1) & m_mask;
+  }
+  m_cells[idx] = Cell{key, m_stamp, 0, 0};
+  m_occupied.push_back(idx);
+  return idx;
+}
+
+const VoxelHash::Cell* VoxelHash::find(uint64_t key) const
+{
+  if (m_cells.empty()) {
+    return nullptr;
+  }
+  size_t idx = ((key * 0x9E3779B97F4A7C15ull) >> 32) & m_mask;
+  while (m_cells[idx].stamp == m_stamp) {
+    if (m_cells[idx].key == key) {
+      return &m_cells[idx];
+    }
+    idx = (idx + 1) & m_mask;
+  }
+  return nullptr;
+}
+
+} // namespace motion_capture_tracking
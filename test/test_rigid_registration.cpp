@@ -0,0 +1,155 @@
+// Checks FixedRigidRegistration against PCL's ICP, which libobjecttracker
+// uses, on synthetic poses.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <gtest/gtest.h>
+#include <pcl/registration/icp.h>
+
+#include "motion_capture_tracking/rigid_registration.h"
+
+using motion_capture_tracking::RigidRegistration;
+
+namespace {
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+
+// markers within a 10 cm cube, at least 2 cm apart, as on a small quadrotor
+Cloud::Ptr randomMarkers(size_t numMarkers, std::mt19937& rng)
+{
+  std::uniform_real_distribution<float> coordinate(-0.05, 0.05);
+  Cloud::Ptr markers(new Cloud);
+  while (markers->size() < numMarkers) {
+    const Eigen::Vector3f position(coordinate(rng), coordinate(rng), coordinate(rng));
+    const bool separated = std::all_of(markers->begin(), markers->end(), [&](const pcl::PointXYZ& marker) {
+      return (marker.getVector3fMap() - position).norm() > 0.02;
+    });
+    if (separated) {
+      markers->push_back(pcl::PointXYZ(position.x(), position.y(), position.z()));
+    }
+  }
+  return markers;
+}
+
+Eigen::Affine3f randomPose(float maxTranslation, float maxAngle, std::mt19937& rng)
+{
+  std::uniform_real_distribution<float> uniform(-1, 1);
+  const Eigen::Vector3f axis = Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng)).normalized();
+  Eigen::Affine3f pose(Eigen::AngleAxisf(maxAngle * uniform(rng), axis));
+  pose.translation() = maxTranslation * Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng));
+  return pose;
+}
+
+// The markers at pose, and distractors at least 30 cm away from them, shuffled
+Cloud::Ptr frame(const Cloud& markers, const Eigen::Affine3f& pose, size_t numDistractors, std::mt19937& rng)
+{
+  Cloud::Ptr cloud(new Cloud);
+  for (const auto& marker : markers) {
+    const Eigen::Vector3f position = pose * marker.getVector3fMap();
+    cloud->push_back(pcl::PointXYZ(position.x(), position.y(), position.z()));
+  }
+  std::uniform_real_distribution<float> coordinate(-2, 2);
+  while (cloud->size() < markers.size() + numDistractors) {
+    const Eigen::Vector3f position(coordinate(rng), coordinate(rng), coordinate(rng));
+    if ((position - pose.translation()).norm() > 0.3) {
+      cloud->push_back(pcl::PointXYZ(position.x(), position.y(), position.z()));
+    }
+  }
+  std::shuffle(cloud->points.begin(), cloud->points.end(), rng);
+  return cloud;
+}
+
+float angle(const Eigen::Affine3f& a, const Eigen::Affine3f& b)
+{
+  return Eigen::AngleAxisf(a.rotation().transpose() * b.rotation()).angle();
+}
+
+} // anonymous namespace
+
+TEST(RigidRegistration, MatchesPclIcp)
+{
+  std::mt19937 rng(42);
+  for (size_t numMarkers = 3; numMarkers <= 6; ++numMarkers) {
+    for (int trial = 0; trial < 50; ++trial) {
+      const Cloud::Ptr markers = randomMarkers(numMarkers, rng);
+      const auto registration = RigidRegistration::create(*markers);
+      ASSERT_TRUE(registration);
+
+      const Eigen::Affine3f pose = randomPose(2, M_PI, rng);
+      const Eigen::Affine3f guess = pose * randomPose(0.01, 0.1, rng);
+      const Cloud::Ptr cloud = frame(*markers, pose, 10, rng);
+
+      RigidRegistration::Result result;
+      ASSERT_TRUE(registration->align(*cloud, guess, 20, result));
+
+      pcl::IterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
+      icp.setInputSource(markers);
+      icp.setInputTarget(cloud);
+      icp.setMaximumIterations(20);
+      Cloud aligned;
+      icp.align(aligned, guess.matrix());
+      ASSERT_TRUE(icp.hasConverged());
+      const Eigen::Affine3f expected(icp.getFinalTransformation());
+
+      EXPECT_LT((result.transformation.translation() - pose.translation()).norm(), 1e-4);
+      EXPECT_LT(angle(result.transformation, pose), 1e-3);
+      EXPECT_LT((result.transformation.translation() - expected.translation()).norm(), 1e-4);
+      EXPECT_LT(angle(result.transformation, expected), 1e-3);
+      EXPECT_NEAR(result.fitness, icp.getFitnessScore(), 1e-8);
+    }
+  }
+}
+
+TEST(RigidRegistration, MissingMarker)
+{
+  std::mt19937 rng(7);
+  for (size_t numMarkers = 4; numMarkers <= 6; ++numMarkers) {
+    for (int trial = 0; trial < 50; ++trial) {
+      const Cloud::Ptr markers = randomMarkers(numMarkers, rng);
+      const auto registration = RigidRegistration::create(*markers);
+      ASSERT_TRUE(registration);
+
+      const Eigen::Affine3f pose = randomPose(2, M_PI, rng);
+      const Eigen::Affine3f guess = pose * randomPose(0.005, 0.05, rng);
+      Cloud::Ptr cloud = frame(*markers, pose, 0, rng);
+      cloud->points.pop_back();
+
+      // the point nearest to the missing marker only pulls its own marker
+      RigidRegistration::Result result;
+      ASSERT_TRUE(registration->align(*cloud, guess, 20, result));
+      EXPECT_LT((result.transformation.translation() - pose.translation()).norm(), 1e-4);
+      EXPECT_LT(angle(result.transformation, pose), 1e-3);
+    }
+  }
+}
+
+TEST(RigidRegistration, TooFewPoints)
+{
+  std::mt19937 rng(1);
+  const Cloud::Ptr markers = randomMarkers(4, rng);
+  const auto registration = RigidRegistration::create(*markers);
+  ASSERT_TRUE(registration);
+
+  Cloud cloud;
+  RigidRegistration::Result result;
+  EXPECT_FALSE(registration->align(cloud, Eigen::Affine3f::Identity(), 20, result));
+
+  cloud.push_back((*markers)[0]);
+  cloud.push_back((*markers)[1]);
+  EXPECT_FALSE(registration->align(cloud, Eigen::Affine3f::Identity(), 20, result));
+}
+
+TEST(RigidRegistration, UnsupportedSize)
+{
+  std::mt19937 rng(1);
+  EXPECT_FALSE(RigidRegistration::create(*randomMarkers(2, rng)));
+  EXPECT_FALSE(RigidRegistration::create(*randomMarkers(7, rng)));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}